@@ -56,6 +56,13 @@ ifdef FW_PAYLOAD_ALIGN
 firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_ALIGN=$(FW_PAYLOAD_ALIGN)
 endif
 
+ifeq ($(FW_PAYLOAD_BENCH),y)
+firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_BENCH
+endif
+ifeq ($(FW_PAYLOAD_TEST_SMP),y)
+firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_TEST_SMP
+endif
+
 ifdef FW_PAYLOAD_FDT_OFFSET
 firmware-genflags-$(FW_PAYLOAD) += -DFW_PAYLOAD_FDT_OFFSET=$(FW_PAYLOAD_FDT_OFFSET)
 endif
@@ -46,15 +46,298 @@ static inline void sbi_ecall_console_puts(const char *str)
 		  sbi_strlen(str), (unsigned long)str, 0, 0, 0, 0);
 }
 
+static void sbi_ecall_console_putnum(unsigned long num)
+{
+	char buf[3 * sizeof(num) + 1];
+	int pos = sizeof(buf) - 1;
+
+	buf[pos] = '\0';
+	do {
+		buf[--pos] = '0' + (num % 10);
+		num /= 10;
+	} while (num);
+
+	sbi_ecall_console_puts(&buf[pos]);
+}
+
 #define wfi()                                             \
 	do {                                              \
 		__asm__ __volatile__("wfi" ::: "memory"); \
 	} while (0)
 
+static inline unsigned long read_time(void)
+{
+	unsigned long t;
+
+	__asm__ __volatile__("rdtime %0" : "=r"(t));
+
+	return t;
+}
+
+#ifdef FW_PAYLOAD_BENCH
+
+#define BENCH_ITERATIONS	1000
+
+static inline unsigned long read_cycle(void)
+{
+	unsigned long c;
+
+	__asm__ __volatile__("rdcycle %0" : "=r"(c));
+
+	return c;
+}
+
+static void test_bench_print(const char *name, unsigned long cycles,
+			     const char *unit)
+{
+	sbi_ecall_console_puts(name);
+	sbi_ecall_console_puts(": ");
+	sbi_ecall_console_putnum(cycles / BENCH_ITERATIONS);
+	sbi_ecall_console_puts(" cycles per ");
+	sbi_ecall_console_puts(unit);
+	sbi_ecall_console_puts("\n");
+}
+
+/*
+ * Count cycles per SBI call. The BASE call always takes the regular
+ * trap path so it is the reference for the calls served by the SBI
+ * call fast path when the firmware is built with it.
+ */
+static void test_bench_ecall(const char *name, int ext, int fid,
+			     unsigned long arg0)
+{
+	unsigned long i, start;
+
+	start = read_cycle();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		sbi_ecall(ext, fid, arg0, 0, 0, 0, 0, 0);
+
+	test_bench_print(name, read_cycle() - start, "call");
+}
+
+/*
+ * Count cycles per read of a started firmware counter. Reading an
+ * unconfigured counter would only time the parameter check.
+ */
+static void test_bench_pmu_fw_read(void)
+{
+	unsigned long mask = -1UL;
+	struct sbiret ret;
+
+	ret = sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_NUM_COUNTERS,
+			0, 0, 0, 0, 0, 0);
+	if (!ret.error && ret.value < 8 * sizeof(mask))
+		mask = (1UL << ret.value) - 1;
+
+	ret = sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_CFG_MATCH, 0, mask,
+			SBI_PMU_CFG_FLAG_CLEAR_VALUE |
+			SBI_PMU_CFG_FLAG_AUTO_START,
+			(SBI_PMU_EVENT_TYPE_FW << 16) | SBI_PMU_FW_SET_TIMER,
+			0, 0);
+	if (ret.error) {
+		sbi_ecall_console_puts("PMU counter_fw_read: no counter\n");
+		return;
+	}
+
+	test_bench_ecall("PMU counter_fw_read", SBI_EXT_PMU,
+			 SBI_EXT_PMU_COUNTER_FW_READ, ret.value);
+
+	sbi_ecall(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_STOP, ret.value, 1,
+		  SBI_PMU_STOP_FLAG_RESET, 0, 0, 0);
+}
+
+#if __riscv_xlen == 64
+#define BENCH_LOAD	"ld"
+#define BENCH_STORE	"sd"
+#else
+#define BENCH_LOAD	"lw"
+#define BENCH_STORE	"sw"
+#endif
+
+static unsigned long bench_buf[4];
+
+/*
+ * Count cycles per misaligned word load and store. On HARTs without
+ * hardware support for misaligned accesses, this is the cost of the
+ * emulation in the trap handler.
+ */
+static void test_bench_misaligned(void)
+{
+	unsigned long i, start, val = 0;
+	char *addr = (char *)bench_buf + 1;
+
+	start = read_cycle();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		__asm__ __volatile__(BENCH_LOAD " %0, 0(%1)"
+				     : "=r"(val) : "r"(addr) : "memory");
+	test_bench_print("misaligned load", read_cycle() - start, "access");
+
+	start = read_cycle();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		__asm__ __volatile__(BENCH_STORE " %0, 0(%1)"
+				     : : "r"(val), "r"(addr) : "memory");
+	test_bench_print("misaligned store", read_cycle() - start, "access");
+}
+
+#define BENCH_MAX_HARTS		32
+
+extern char _start_hang[];
+
+/*
+ * Count cycles per remote FENCE.I round trip to another HART parked in
+ * a WFI loop. Each round trip writes the IPI type of the remote HART
+ * and the pending fence count of the local HART from the other side,
+ * which is where the cache line isolation of remote written scratch
+ * data matters.
+ */
+static void test_bench_remote_fence(unsigned long boot_hartid)
+{
+	unsigned long i, hart, start;
+	struct sbiret ret;
+
+	for (hart = 0; hart < BENCH_MAX_HARTS; hart++) {
+		if (hart == boot_hartid)
+			continue;
+		ret = sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_START, hart,
+				(unsigned long)_start_hang, 0, 0, 0, 0);
+		if (!ret.error)
+			break;
+	}
+	if (hart == BENCH_MAX_HARTS) {
+		sbi_ecall_console_puts("remote fence: no other HART\n");
+		return;
+	}
+
+	do {
+		ret = sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_GET_STATUS, hart,
+				0, 0, 0, 0, 0);
+	} while (!ret.error && ret.value != SBI_HSM_STATE_STARTED);
+
+	start = read_cycle();
+	for (i = 0; i < BENCH_ITERATIONS; i++)
+		sbi_ecall(SBI_EXT_RFENCE, SBI_EXT_RFENCE_REMOTE_FENCE_I,
+			  1, hart, 0, 0, 0, 0);
+
+	test_bench_print("remote fence", read_cycle() - start, "round trip");
+}
+
+static void test_bench(unsigned long boot_hartid)
+{
+#ifdef CONFIG_SBI_ECALL_FAST_PATH
+	sbi_ecall_console_puts("SBI call fast path: enabled\n");
+#else
+	sbi_ecall_console_puts("SBI call fast path: disabled\n");
+#endif
+#ifdef CONFIG_SBI_SCRATCH_REMOTE_ISOLATION
+	sbi_ecall_console_puts("scratch remote isolation: enabled\n");
+#else
+	sbi_ecall_console_puts("scratch remote isolation: disabled\n");
+#endif
+	test_bench_ecall("BASE get_spec_version", SBI_EXT_BASE,
+			 SBI_EXT_BASE_GET_SPEC_VERSION, 0);
+	test_bench_ecall("TIME set_timer", SBI_EXT_TIME,
+			 SBI_EXT_TIME_SET_TIMER, -1UL);
+	test_bench_pmu_fw_read();
+	test_bench_misaligned();
+	test_bench_remote_fence(boot_hartid);
+}
+
+#endif
+
+#ifdef FW_PAYLOAD_TEST_SMP
+
+#define TEST_SMP_MAX_HARTS	32
+#define TEST_SMP_STACK_SIZE	4096
+#define TEST_SMP_ITERATIONS	1000
+
+/* About 10 seconds with the 10MHz timebase of QEMU virt */
+#define TEST_SMP_STALL_TICKS	100000000UL
+
+extern char _start_secondary[];
+
+static unsigned long test_smp_stack[TEST_SMP_MAX_HARTS]
+				   [TEST_SMP_STACK_SIZE / sizeof(unsigned long)]
+	__attribute__((aligned(16)));
+static unsigned long test_smp_go, test_smp_done, test_smp_progress;
+
+static void test_smp_fences(void)
+{
+	unsigned long i;
+
+	while (!__atomic_load_n(&test_smp_go, __ATOMIC_ACQUIRE))
+		;
+
+	for (i = 0; i < TEST_SMP_ITERATIONS; i++) {
+		sbi_ecall(SBI_EXT_RFENCE, SBI_EXT_RFENCE_REMOTE_FENCE_I,
+			  0, -1UL, 0, 0, 0, 0);
+		__atomic_fetch_add(&test_smp_progress, 1, __ATOMIC_RELAXED);
+	}
+
+	__atomic_fetch_add(&test_smp_done, 1, __ATOMIC_RELEASE);
+}
+
+void test_smp_secondary(unsigned long hartid)
+{
+	test_smp_fences();
+	sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_STOP, 0, 0, 0, 0, 0, 0);
+}
+
+/*
+ * Broadcast remote fences from all HARTs at the same time so that
+ * HARTs are asked to process fences while waiting for their own ones.
+ * With CONFIG_SBI_IPI_TREE_FANOUT, this includes group leaders asked
+ * to trigger the other HARTs of their group. A missing result line
+ * means that the boot HART itself got stuck in the firmware.
+ */
+static void test_smp(unsigned long boot_hartid)
+{
+	unsigned long i, harts = 1, progress = 0, stamp;
+	struct sbiret ret;
+
+	for (i = 0; i < TEST_SMP_MAX_HARTS; i++) {
+		if (i == boot_hartid)
+			continue;
+		ret = sbi_ecall(SBI_EXT_HSM, SBI_EXT_HSM_HART_START, i,
+				(unsigned long)_start_secondary,
+				(unsigned long)&test_smp_stack[i + 1], 0, 0, 0);
+		if (!ret.error)
+			harts++;
+	}
+
+	__atomic_store_n(&test_smp_go, 1, __ATOMIC_RELEASE);
+	test_smp_fences();
+
+	stamp = read_time();
+	while (__atomic_load_n(&test_smp_done, __ATOMIC_ACQUIRE) < harts) {
+		if (progress != __atomic_load_n(&test_smp_progress,
+						__ATOMIC_RELAXED)) {
+			progress = __atomic_load_n(&test_smp_progress,
+						   __ATOMIC_RELAXED);
+			stamp = read_time();
+		} else if (read_time() - stamp > TEST_SMP_STALL_TICKS) {
+			sbi_ecall_console_puts("SMP remote fences: stalled\n");
+			return;
+		}
+	}
+
+	sbi_ecall_console_puts("SMP remote fences: ");
+	sbi_ecall_console_putnum(harts);
+	sbi_ecall_console_puts(" HARTs done\n");
+}
+
+#endif
+
 void test_main(unsigned long a0, unsigned long a1)
 {
 	sbi_ecall_console_puts("\nTest payload running\n");
 
+#ifdef FW_PAYLOAD_BENCH
+	test_bench(a0);
+#endif
+#ifdef FW_PAYLOAD_TEST_SMP
+	test_smp(a0);
+#endif
+
 	while (1)
 		wfi();
 }
@@ -10,6 +10,7 @@
 #ifndef __SBI_ECALL_H__
 #define __SBI_ECALL_H__
 
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_types.h>
 #include <sbi/sbi_list.h>
 
@@ -20,6 +21,52 @@
 struct sbi_trap_regs;
 struct sbi_trap_context;
 
+/* Number and granularity of SBI call latency histogram buckets */
+#define SBI_ECALL_STATS_BUCKETS		16
+#define SBI_ECALL_STATS_BUCKET_SHIFT	6
+
+/* Number of SBI functions with their own histogram on each HART */
+#define SBI_ECALL_STATS_SLOTS		16
+
+/** Heap space used per HART by the SBI call latency histograms */
+#ifdef CONFIG_SBI_ECALL_STATS
+#define SBI_ECALL_STATS_HEAP_SIZE	1536
+#else
+#define SBI_ECALL_STATS_HEAP_SIZE	0
+#endif
+
+/**
+ * Latency histogram of one SBI function on one HART
+ *
+ * Bucket 0 counts calls taking less than 2^SHIFT cycles and bucket i
+ * counts calls taking [2^(SHIFT+i-1), 2^(SHIFT+i)) cycles. The last
+ * bucket also counts all longer calls. Calls of SBI functions which
+ * did not fit in the per-HART table are accounted with extid and funcid
+ * set to -1UL.
+ */
+struct sbi_ecall_stats_entry {
+	unsigned long extid;
+	unsigned long funcid;
+	u32 hist[SBI_ECALL_STATS_BUCKETS];
+};
+
+/* Maximum number of SBI calls in one multicall */
+#define SBI_MULTICALL_MAX		64
+
+/**
+ * One SBI call of a multicall
+ *
+ * The caller fills extid, funcid and args. The firmware writes back
+ * the error code and value returned by the SBI call.
+ */
+struct sbi_multicall_entry {
+	unsigned long extid;
+	unsigned long funcid;
+	unsigned long args[6];
+	long error;
+	unsigned long value;
+};
+
 struct sbi_ecall_return {
 	/* Return flag to skip register update */
 	bool skip_regs_update;
@@ -73,6 +120,12 @@ struct sbi_ecall_extension {
 		       struct sbi_ecall_return *out);
 };
 
+/*
+ * Return value of a fast path handler which makes the SBI call take
+ * the regular trap path instead (any positive value).
+ */
+#define SBI_ECALL_FAST_FALLBACK		1
+
 u16 sbi_ecall_version_major(void);
 
 u16 sbi_ecall_version_minor(void);
@@ -87,8 +140,45 @@ int sbi_ecall_register_extension(struct sbi_ecall_extension *ext);
 
 void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext);
 
+#ifdef CONFIG_SBI_ECALL_FAST_PATH
+
+int sbi_ecall_register_fast(unsigned long extid, unsigned long funcid,
+			    int (*handle)(unsigned long a0, unsigned long a1,
+					  unsigned long *out_val));
+
+#else
+
+static inline int sbi_ecall_register_fast(unsigned long extid,
+					  unsigned long funcid,
+					  int (*handle)(unsigned long a0,
+							unsigned long a1,
+							unsigned long *out_val))
+{
+	return 0;
+}
+
+#endif
+
 int sbi_ecall_handler(struct sbi_trap_context *tcntx);
 
+#ifdef CONFIG_SBI_ECALL_STATS
+
+int sbi_ecall_stats_read(u32 hartindex, void *buf, unsigned long count);
+
+void sbi_ecall_stats_dump(void);
+
+#else
+
+static inline int sbi_ecall_stats_read(u32 hartindex, void *buf,
+				       unsigned long count)
+{
+	return SBI_ENOTSUPP;
+}
+
+static inline void sbi_ecall_stats_dump(void) { }
+
+#endif
+
 int sbi_ecall_init(void);
 
 #endif
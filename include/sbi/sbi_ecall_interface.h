@@ -231,6 +231,15 @@ enum sbi_pmu_fw_event_code_id {
 	 * Event codes 256 to 65534 are reserved for SBI implementation
 	 * specific custom firmware events.
 	 */
+	SBI_PMU_FW_IMPL_BASE		= 256,
+	SBI_PMU_FW_TLB_GEN_HIT		= SBI_PMU_FW_IMPL_BASE,
+	SBI_PMU_FW_TLB_GEN_MISS		= 257,
+	SBI_PMU_FW_TRAP_REDIRECT	= 258,
+	SBI_PMU_FW_TRAP_NESTED		= 259,
+	SBI_PMU_FW_ILLEGAL_INSN_REDIRECT = 260,
+	SBI_PMU_FW_ILLEGAL_INSN_FENCE_TSO = 261,
+	SBI_PMU_FW_ILLEGAL_INSN_CSR	= 262,
+	SBI_PMU_FW_IMPL_MAX,
 	SBI_PMU_FW_RESERVED_MAX = 0xFFFE,
 	/*
 	 * Event code 0xFFFF is used for platform specific firmware
@@ -415,6 +424,16 @@ enum sbi_sse_state {
 #define SBI_EXT_FIRMWARE_START			0x0A000000
 #define SBI_EXT_FIRMWARE_END			0x0AFFFFFF
 
+/* OpenSBI firmware specific extension (low bits are the OpenSBI impid) */
+#define SBI_EXT_OPENSBI				(SBI_EXT_FIRMWARE_START + 0x1)
+
+/* SBI function IDs for OpenSBI firmware specific extension */
+#define SBI_EXT_OPENSBI_ECALL_STATS		0x0
+#define SBI_EXT_OPENSBI_MULTICALL		0x1
+#define SBI_EXT_OPENSBI_RFENCE_RING_SETUP	0x2
+#define SBI_EXT_OPENSBI_RFENCE_RING_DOORBELL	0x3
+#define SBI_EXT_OPENSBI_HEAP_STATS		0x4
+
 /* SBI return error codes */
 #define SBI_SUCCESS				0
 #define SBI_ERR_FAILED				-1
@@ -10,6 +10,7 @@
 #ifndef __SBI_HEAP_H__
 #define __SBI_HEAP_H__
 
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_types.h>
 
 /* Alignment of heap base address and size */
@@ -17,6 +18,28 @@
 
 struct sbi_scratch;
 
+/** Heap statistics as returned by sbi_heap_stats_read() */
+struct sbi_heap_stats {
+	/** Bytes of the heap usable for allocations */
+	unsigned long size;
+	/** Bytes held by allocated blocks */
+	unsigned long used;
+	/** Highest number of bytes held by allocated blocks */
+	unsigned long peak_used;
+	/** Bytes free, including free blocks of size classes and caches */
+	unsigned long free;
+	/** Size of the largest free block of the first-fit heap */
+	unsigned long largest_free;
+	/** Number of free blocks of the first-fit heap */
+	unsigned long free_blocks;
+	/** Number of allocated blocks */
+	unsigned long used_blocks;
+	unsigned long allocs;
+	unsigned long frees;
+	/** Allocations which failed for lack of a large enough free block */
+	unsigned long failures;
+};
+
 /** Allocate from heap area */
 void *sbi_malloc(size_t size);
 
@@ -41,6 +64,48 @@ unsigned long sbi_heap_used_space(void);
 /** Amount (in bytes) of reserved space in the heap area */
 unsigned long sbi_heap_reserved_space(void);
 
+#if defined(CONFIG_SBI_HEAP_HART_CACHE) || defined(CONFIG_SBI_HEAP_STATS)
+
+/** Print heap usage and allocation cache statistics */
+void sbi_heap_stats_dump(void);
+
+#else
+
+static inline void sbi_heap_stats_dump(void) { }
+
+#endif
+
+#ifdef CONFIG_SBI_HEAP_STATS
+
+/** Allocate from heap area accounted to a call site */
+void *sbi_malloc_site(size_t size, const char *site);
+
+/** Zero allocate from heap area accounted to a call site */
+void *sbi_zalloc_site(size_t size, const char *site);
+
+/* Account all allocations to the calling function */
+#define sbi_malloc(__size)		sbi_malloc_site((__size), __func__)
+#define sbi_zalloc(__size)		sbi_zalloc_site((__size), __func__)
+#define sbi_calloc(__nitems, __size)	\
+	sbi_zalloc_site((__nitems) * (__size), __func__)
+
+/** Read a snapshot of the heap statistics */
+int sbi_heap_stats_read(struct sbi_heap_stats *stats);
+
+/** Print the heap statistics and the allocations by call site */
+void sbi_heap_stats_print(void);
+
+#else
+
+static inline int sbi_heap_stats_read(struct sbi_heap_stats *stats)
+{
+	return SBI_ENOTSUPP;
+}
+
+static inline void sbi_heap_stats_print(void) { }
+
+#endif
+
 /** Initialize heap area */
 int sbi_heap_init(struct sbi_scratch *scratch);
 
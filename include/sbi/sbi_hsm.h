@@ -52,6 +52,7 @@ struct sbi_hsm_device {
 };
 
 struct sbi_domain;
+struct sbi_hartmask;
 struct sbi_scratch;
 
 const struct sbi_hsm_device *sbi_hsm_get_device(void);
@@ -74,6 +75,8 @@ bool sbi_hsm_hart_change_state(struct sbi_scratch *scratch, long oldstate,
 			       long newstate);
 int __sbi_hsm_hart_get_state(u32 hartid);
 int sbi_hsm_hart_get_state(const struct sbi_domain *dom, u32 hartid);
+int sbi_hsm_hart_interruptible_hartmask(const struct sbi_domain *dom,
+					struct sbi_hartmask *out_mask);
 int sbi_hsm_hart_interruptible_mask(const struct sbi_domain *dom,
 				    ulong hbase, ulong *out_hmask);
 void __sbi_hsm_suspend_non_ret_save(struct sbi_scratch *scratch);
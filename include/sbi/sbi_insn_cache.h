@@ -0,0 +1,76 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Per-HART cache of instructions fetched for trap emulation
+ */
+
+#ifndef __SBI_INSN_CACHE_H__
+#define __SBI_INSN_CACHE_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+#define SBI_INSN_CACHE_ENTRIES		8
+
+/* clang-format on */
+
+struct sbi_scratch;
+struct sbi_trap_regs;
+
+enum sbi_insn_type {
+	/** Instruction as fetched */
+	SBI_INSN_RAW = 0,
+	/** Decoded load with the destination register in the RD field */
+	SBI_INSN_LOAD,
+	/** Decoded store with the source register in the RS2 field */
+	SBI_INSN_STORE,
+};
+
+/** Instruction fetched (and possibly decoded) for a trap */
+struct sbi_insn_info {
+	ulong insn;
+	u8 insn_len;
+	u8 type;
+	/** Access width of a load or store */
+	u8 len;
+	/** Sign extension shift of a load */
+	u8 shift;
+	/** Load or store of a floating point register */
+	bool fp;
+};
+
+#ifdef CONFIG_SBI_INSN_CACHE
+
+bool sbi_insn_cache_lookup(const struct sbi_trap_regs *regs, u8 type,
+			   struct sbi_insn_info *info);
+
+void sbi_insn_cache_insert(const struct sbi_trap_regs *regs,
+			   const struct sbi_insn_info *info);
+
+void sbi_insn_cache_flush(void);
+
+int sbi_insn_cache_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#else
+
+static inline bool sbi_insn_cache_lookup(const struct sbi_trap_regs *regs,
+					 u8 type, struct sbi_insn_info *info)
+{
+	return false;
+}
+
+static inline void sbi_insn_cache_insert(const struct sbi_trap_regs *regs,
+					 const struct sbi_insn_info *info) { }
+
+static inline void sbi_insn_cache_flush(void) { }
+
+static inline int sbi_insn_cache_init(struct sbi_scratch *scratch,
+				      bool cold_boot)
+{
+	return 0;
+}
+
+#endif
+
+#endif
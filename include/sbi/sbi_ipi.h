@@ -18,6 +18,8 @@
 
 /* clang-format on */
 
+struct sbi_hartmask;
+
 /** IPI hardware device */
 struct sbi_ipi_device {
 	/** Name of the IPI device */
@@ -26,6 +28,13 @@ struct sbi_ipi_device {
 	/** Send IPI to a target HART index */
 	void (*ipi_send)(u32 hart_index);
 
+	/**
+	 * Send IPI to all HART indices in a hartmask
+	 * Note: This is an optional callback. When available, it is used
+	 * to trigger all targets of an IPI event at once.
+	 */
+	void (*ipi_send_mask)(const struct sbi_hartmask *mask);
+
 	/** Clear IPI for a target HART index */
 	void (*ipi_clear)(u32 hart_index);
 };
@@ -73,6 +82,14 @@ struct sbi_ipi_event_ops {
 
 int sbi_ipi_send_many(ulong hmask, ulong hbase, u32 event, void *data);
 
+int sbi_ipi_set_hart_group(u32 hartindex, u32 group);
+
+#ifdef CONFIG_SBI_IPI_TREE_FANOUT
+void sbi_ipi_forward(struct sbi_scratch *scratch);
+#else
+static inline void sbi_ipi_forward(struct sbi_scratch *scratch) { }
+#endif
+
 int sbi_ipi_event_create(const struct sbi_ipi_event_ops *ops);
 
 void sbi_ipi_event_destroy(u32 event);
@@ -87,6 +104,8 @@ void sbi_ipi_process(void);
 
 int sbi_ipi_raw_send(u32 hartindex);
 
+int sbi_ipi_raw_send_mask(const struct sbi_hartmask *mask);
+
 void sbi_ipi_raw_clear(u32 hartindex);
 
 const struct sbi_ipi_device *sbi_ipi_get_device(void);
@@ -0,0 +1,44 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Lock-free multi-producer/single-consumer ring
+ *
+ * Producers reserve a slot by atomically advancing the head position
+ * and publish the entry through a per-slot sequence number, so no lock
+ * is shared between the senders. Only the owning HART dequeues.
+ */
+
+#ifndef __SBI_MPSC_RING_H__
+#define __SBI_MPSC_RING_H__
+
+#include <sbi/riscv_atomic.h>
+#include <sbi/sbi_types.h>
+
+/** Size (in bytes) of a ring slot holding an entry of given size */
+#define SBI_MPSC_RING_SLOT_SIZE(__entry_size)				\
+	(sizeof(unsigned long) +					\
+	 ROUNDUP((__entry_size), sizeof(unsigned long)))
+
+/** Size (in bytes) of the memory backing a ring */
+#define SBI_MPSC_RING_MEM_SIZE(__entries, __entry_size)		\
+	((__entries) * SBI_MPSC_RING_SLOT_SIZE(__entry_size))
+
+struct sbi_mpsc_ring {
+	void *queue;
+	u16 entry_size;
+	u16 slot_size;
+	/** Number of slots (must be a power of two) */
+	u16 num_entries;
+	/** Next position to be reserved by a producer */
+	atomic_t head;
+	/** Next position to be consumed (owned by the consumer) */
+	unsigned long tail;
+};
+
+int sbi_mpsc_ring_init(struct sbi_mpsc_ring *ring, void *queue_mem,
+		       u16 entries, u16 entry_size);
+int sbi_mpsc_ring_enqueue(struct sbi_mpsc_ring *ring, void *data);
+int sbi_mpsc_ring_dequeue(struct sbi_mpsc_ring *ring, void *data);
+bool sbi_mpsc_ring_is_empty(struct sbi_mpsc_ring *ring);
+
+#endif
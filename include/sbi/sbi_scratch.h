@@ -46,6 +46,11 @@
 #define SBI_SCRATCH_EXTRA_SPACE_OFFSET		(14 * __SIZEOF_POINTER__)
 /** Maximum size of sbi_scratch (4KB) */
 #define SBI_SCRATCH_SIZE			(0x1000)
+/** Cache line size assumed when placing extra space allocations */
+#define SBI_SCRATCH_CACHE_LINE_SIZE		64
+
+/** Extra space written by remote HARTs, gets cache lines of its own */
+#define SBI_SCRATCH_ALLOC_REMOTE		(1UL << 0)
 
 /* clang-format on */
 
@@ -172,6 +177,23 @@ int sbi_scratch_init(struct sbi_scratch *scratch);
  */
 unsigned long sbi_scratch_alloc_offset(unsigned long size);
 
+/**
+ * Allocate from extra space in sbi_scratch with a given alignment
+ *
+ * The alignment must be a power of two, smaller alignments are raised
+ * to the pointer size. With SBI_SCRATCH_ALLOC_REMOTE in flags, the
+ * allocation is aligned and padded to whole cache lines so that data
+ * written by remote HARTs does not share a cache line with data written
+ * by the owning HART. The flag is ignored without
+ * CONFIG_SBI_SCRATCH_REMOTE_ISOLATION.
+ *
+ * @return zero on failure and non-zero (>= SBI_SCRATCH_EXTRA_SPACE_OFFSET)
+ * on success
+ */
+unsigned long sbi_scratch_alloc_offset_aligned(unsigned long size,
+					       unsigned long align,
+					       unsigned long flags);
+
 /** Free-up extra space in sbi_scratch */
 void sbi_scratch_free_offset(unsigned long offset);
 
@@ -23,6 +23,13 @@ struct sbi_timer_device {
 	/** Get free-running timer value */
 	u64 (*timer_value)(void);
 
+	/**
+	 * Get address of the memory mapped free-running timer of current
+	 * HART (optional). The timer must be readable with a single 64-bit
+	 * load on RV64 and with 32-bit loads on RV32.
+	 */
+	volatile u64 *(*timer_value_addr)(void);
+
 	/** Start timer event for current HART */
 	void (*timer_event_start)(u64 next_event);
 
@@ -31,6 +38,7 @@ struct sbi_timer_device {
 };
 
 struct sbi_scratch;
+struct sbi_trap_regs;
 
 /** Generic delay loop of desired granularity */
 void sbi_timer_delay_loop(ulong units, u64 unit_freq,
@@ -81,6 +89,9 @@ void sbi_timer_set_delta(ulong delta);
 /** Set upper 32-bits of timer delta value for current HART */
 void sbi_timer_set_delta_upper(ulong delta_upper);
 
+/** Emulate a trapped rdtime/rdtimeh instruction, return true if done */
+bool sbi_timer_emulate_rdtime(struct sbi_trap_regs *regs, ulong insn);
+
 /** Start timer event for current HART */
 void sbi_timer_event_start(u64 next_event);
 
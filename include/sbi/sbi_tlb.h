@@ -12,12 +12,24 @@
 #define __SBI_TLB_H__
 
 #include <sbi/sbi_types.h>
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_hartmask.h>
+#include <sbi/sbi_mpsc_ring.h>
 
 /* clang-format off */
 
 #define SBI_TLB_FLUSH_ALL			((unsigned long)-1)
 
+/** Maximum number of merged address ranges of a pending invalidation */
+#define SBI_TLB_PENDING_MAX_RANGES		4
+
+/** Heap space used per HART to record the generations of full flushes */
+#ifdef CONFIG_SBI_TLB_FLUSH_GEN
+#define SBI_TLB_FLUSH_GEN_HEAP_SIZE		1024
+#else
+#define SBI_TLB_FLUSH_GEN_HEAP_SIZE		0
+#endif
+
 /* clang-format on */
 
 struct sbi_scratch;
@@ -39,6 +51,8 @@ struct sbi_tlb_info {
 	uint16_t asid;
 	uint16_t vmid;
 	enum sbi_tlb_type type;
+	/** Flush generation observed when the request was issued */
+	unsigned long gen;
 	struct sbi_hartmask smask;
 };
 
@@ -49,13 +63,122 @@ do { \
 	(__p)->asid = (__asid); \
 	(__p)->vmid = (__vmid); \
 	(__p)->type = (__type); \
+	(__p)->gen = 0; \
 	SBI_HARTMASK_INIT_EXCEPT(&(__p)->smask, (__src)); \
 } while (0)
 
 #define SBI_TLB_INFO_SIZE		sizeof(struct sbi_tlb_info)
 
+/**
+ * Pending invalidations of a receiving HART for one (type, ASID/VMID) key
+ * when remote fences are coalesced instead of queued. The address ranges
+ * are sorted, non-overlapping and non-adjacent.
+ */
+struct sbi_tlb_pending {
+	enum sbi_tlb_type type;
+	uint16_t asid;
+	uint16_t vmid;
+	bool flush_all;
+	u32 nranges;
+	unsigned long gen;
+	unsigned long start[SBI_TLB_PENDING_MAX_RANGES];
+	unsigned long end[SBI_TLB_PENDING_MAX_RANGES];
+	struct sbi_hartmask smask;
+};
+
+/**
+ * Reference to a remote fence descriptor published by the sending HART.
+ * The descriptor lives in the scratch space of the sending HART and is
+ * shared by all receiving HARTs of a multicast remote fence.
+ */
+struct sbi_tlb_ref {
+	struct sbi_tlb_info *info;
+	/** Pending count of the sending HART */
+	atomic_t *pending;
+};
+
+/** Size of the data queued for each remote fence request */
+#ifdef CONFIG_SBI_TLB_MULTICAST
+#define SBI_TLB_QUEUE_DATA_SIZE		sizeof(struct sbi_tlb_ref)
+#else
+#define SBI_TLB_QUEUE_DATA_SIZE		SBI_TLB_INFO_SIZE
+#endif
+
+/**
+ * Upper bound of remote fence queue memory per entry. The lock-free ring
+ * rounds the number of entries up to a power of two hence the factor two.
+ */
+#if defined(CONFIG_SBI_TLB_QUEUE_MPSC_RING)
+#define SBI_TLB_QUEUE_ENTRY_SIZE	\
+	(2 * SBI_MPSC_RING_SLOT_SIZE(SBI_TLB_QUEUE_DATA_SIZE))
+#elif defined(CONFIG_SBI_TLB_QUEUE_COALESCE)
+#define SBI_TLB_QUEUE_ENTRY_SIZE	sizeof(struct sbi_tlb_pending)
+#else
+#define SBI_TLB_QUEUE_ENTRY_SIZE	SBI_TLB_QUEUE_DATA_SIZE
+#endif
+
+/**
+ * Header of an asynchronous remote fence ring shared with S-mode. It is
+ * followed by a power of two number of descriptors. Positions are free
+ * running counters and the descriptor of position "pos" is at index
+ * "pos & (num_entries - 1)".
+ */
+struct sbi_rfence_ring_header {
+	/** Next position to be posted (written by S-mode) */
+	unsigned long head;
+	/** Next position to be consumed (written by OpenSBI) */
+	unsigned long tail;
+	/** All descriptors before this position completed (written by OpenSBI) */
+	unsigned long done;
+	/** Non-zero while a doorbell is pending (set by S-mode) */
+	unsigned long doorbell;
+};
+
+/** Descriptor of an asynchronous remote fence */
+struct sbi_rfence_ring_desc {
+	/** Function ID of the SBI RFENCE extension */
+	unsigned long funcid;
+	unsigned long hmask;
+	unsigned long hbase;
+	unsigned long start;
+	unsigned long size;
+	/** ASID or VMID, as required by the function */
+	unsigned long id;
+	/** SBI error of the submission (written by OpenSBI) */
+	long error;
+	unsigned long reserved;
+};
+
+/** Maximum number of descriptors of an asynchronous remote fence ring */
+#define SBI_RFENCE_RING_MAX_ENTRIES	4096
+
+int sbi_tlb_rfence_info_init(struct sbi_tlb_info *tinfo, unsigned long funcid,
+			     unsigned long start, unsigned long size,
+			     unsigned long id);
+
 int sbi_tlb_request(ulong hmask, ulong hbase, struct sbi_tlb_info *tinfo);
 
+#ifdef CONFIG_SBI_TLB_ASYNC
+int sbi_tlb_async_setup(unsigned long num_entries, unsigned long addr);
+int sbi_tlb_async_doorbell(void);
+#else
+static inline int sbi_tlb_async_setup(unsigned long num_entries,
+				      unsigned long addr)
+{
+	return SBI_ENOTSUPP;
+}
+static inline int sbi_tlb_async_doorbell(void)
+{
+	return SBI_ENOTSUPP;
+}
+#endif
+
+unsigned long sbi_tlb_range_flush_limit(enum sbi_tlb_type type);
+
+void sbi_tlb_range_flush_limit_override(unsigned long limit);
+
+bool sbi_tlb_range_flush_limit_calibrated(void);
+
 int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot);
 
 #endif
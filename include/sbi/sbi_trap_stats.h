@@ -0,0 +1,66 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Per-HART trap statistics
+ */
+
+#ifndef __SBI_TRAP_STATS_H__
+#define __SBI_TRAP_STATS_H__
+
+#include <sbi/sbi_types.h>
+
+/* clang-format off */
+
+/** Number of exception causes accounted individually */
+#define SBI_TRAP_STATS_CAUSES		24
+/** Number of interrupt causes accounted individually */
+#define SBI_TRAP_STATS_IRQS		16
+/** Number of opcode classes of 32-bit instructions */
+#define SBI_TRAP_STATS_OPCODES		32
+/** Number of distinct emulated CSRs accounted individually */
+#define SBI_TRAP_STATS_CSR_SLOTS	16
+
+/* clang-format on */
+
+struct sbi_scratch;
+struct sbi_trap_context;
+
+#ifdef CONFIG_SBI_TRAP_STATS
+
+void sbi_trap_stats_trap(const struct sbi_trap_context *tcntx);
+
+void sbi_trap_stats_exception(ulong cause);
+
+void sbi_trap_stats_redirect(ulong cause);
+
+void sbi_trap_stats_illegal_insn(ulong insn);
+
+void sbi_trap_stats_csr(int csr_num);
+
+void sbi_trap_stats_dump(void);
+
+int sbi_trap_stats_init(struct sbi_scratch *scratch, bool cold_boot);
+
+#else
+
+static inline void sbi_trap_stats_trap(const struct sbi_trap_context *tcntx) { }
+
+static inline void sbi_trap_stats_exception(ulong cause) { }
+
+static inline void sbi_trap_stats_redirect(ulong cause) { }
+
+static inline void sbi_trap_stats_illegal_insn(ulong insn) { }
+
+static inline void sbi_trap_stats_csr(int csr_num) { }
+
+static inline void sbi_trap_stats_dump(void) { }
+
+static inline int sbi_trap_stats_init(struct sbi_scratch *scratch,
+				      bool cold_boot)
+{
+	return 0;
+}
+
+#endif
+
+#endif
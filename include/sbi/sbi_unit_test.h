@@ -66,8 +66,26 @@ struct sbiunit_test_suite {
 #define SBIUNIT_EXPECT_STREQ(test, a, b, len) SBIUNIT_EXPECT(test, !sbi_strncmp(a, b, len))
 #define SBIUNIT_ASSERT_STREQ(test, a, b, len) SBIUNIT_ASSERT(test, !sbi_strncmp(a, b, len))
 
+/** Function run on a HART started by sbiunit_harts_start() */
+typedef void (*sbiunit_hart_func)(void *arg, u32 index);
+
+/**
+ * Run a function on up to @count HARTs which wait for HSM start while
+ * the tests run in cold boot. Each HART gets its index from zero to the
+ * returned number of started HARTs minus one. HARTs which do not show
+ * up within a short timeout are left out.
+ */
+u32 sbiunit_harts_start(sbiunit_hart_func func, void *arg, u32 count);
+
+/** Wait for the HARTs started by sbiunit_harts_start() to finish */
+void sbiunit_harts_wait(void);
+
+/** Poll for test work while waiting for HSM start */
+void sbiunit_hsm_wait_poll(void);
+
 void run_all_tests(void);
 #endif
 #else
+#define sbiunit_hsm_wait_poll()
 #define run_all_tests()
 #endif
@@ -38,4 +38,10 @@ DECLARE_UNPRIVILEGED_LOAD_FUNCTION(ulong)
 
 ulong sbi_get_insn(ulong mepc, struct sbi_trap_info *trap);
 
+ulong sbi_copy_from_lower(void *dst, const void *src, ulong len,
+			  struct sbi_trap_info *trap);
+
+ulong sbi_copy_to_lower(void *dst, const void *src, ulong len,
+			struct sbi_trap_info *trap);
+
 #endif
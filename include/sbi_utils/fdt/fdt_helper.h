@@ -57,6 +57,8 @@ int fdt_parse_hart_id(void *fdt, int cpu_offset, u32 *hartid);
 
 int fdt_parse_max_enabled_hart_id(void *fdt, u32 *max_hartid);
 
+int fdt_parse_cpu_cluster(void *fdt, int cpu_offset);
+
 int fdt_parse_timebase_frequency(void *fdt, unsigned long *freq);
 
 int fdt_parse_isa_extensions(void *fdt, unsigned int hard_id,
@@ -7,11 +7,18 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_barrier.h>
+#include <sbi/sbi_bitops.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
 #include <sbi/sbi_trap.h>
+#include <sbi/sbi_trap_stats.h>
 
 extern struct sbi_ecall_extension *sbi_ecall_exts[];
 extern unsigned long sbi_ecall_exts_size;
@@ -40,7 +47,48 @@ void sbi_ecall_set_impid(unsigned long impid)
 
 static SBI_LIST_HEAD(ecall_exts_list);
 
-struct sbi_ecall_extension *sbi_ecall_find_extension(unsigned long extid)
+/*
+ * Lookup structures built by sbi_ecall_init() after all extensions are
+ * registered:
+ * 1) A direct-mapped table hashed by extension ID holding the individual
+ *    IDs of all extensions with a small ID range (i.e. all standard SBI
+ *    extensions and the legacy extensions).
+ * 2) An array of all extensions sorted by extid_start for binary search
+ *    which also covers the wide vendor and firmware ranges.
+ * 3) A per-HART cache of the last extension found.
+ * Registering or unregistering an extension afterwards drops them and
+ * falls back to walking the extension list.
+ */
+#define ECALL_DIRECT_ORDER		6
+#define ECALL_DIRECT_SIZE		(1UL << ECALL_DIRECT_ORDER)
+#define ECALL_DIRECT_RANGE_MAX		16
+#define ECALL_SORTED_MAX		64
+
+struct ecall_direct_entry {
+	unsigned long extid;
+	struct sbi_ecall_extension *ext;
+};
+
+struct ecall_last_hit {
+	unsigned long gen;
+	unsigned long extid;
+	struct sbi_ecall_extension *ext;
+};
+
+static bool ecall_lookup_ready;
+/* Incremented by each build to invalidate the last hit of all HARTs */
+static unsigned long ecall_lookup_gen;
+static struct ecall_direct_entry ecall_direct[ECALL_DIRECT_SIZE];
+static struct sbi_ecall_extension *ecall_sorted[ECALL_SORTED_MAX];
+static unsigned long ecall_sorted_count;
+static unsigned long ecall_last_hit_off;
+
+static inline unsigned long ecall_direct_hash(unsigned long extid)
+{
+	return ((u32)extid * 0x9E3779B1U) >> (32 - ECALL_DIRECT_ORDER);
+}
+
+static struct sbi_ecall_extension *ecall_list_find(unsigned long extid)
 {
 	struct sbi_ecall_extension *t, *ret = NULL;
 
@@ -54,8 +102,94 @@ struct sbi_ecall_extension *sbi_ecall_find_extension(unsigned long extid)
 	return ret;
 }
 
+static struct sbi_ecall_extension *ecall_sorted_find(unsigned long extid)
+{
+	unsigned long lo = 0, hi = ecall_sorted_count, mid;
+	struct sbi_ecall_extension *t;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		t = ecall_sorted[mid];
+		if (extid < t->extid_start)
+			hi = mid;
+		else if (t->extid_end < extid)
+			lo = mid + 1;
+		else
+			return t;
+	}
+
+	return NULL;
+}
+
+static void ecall_lookup_build(void)
+{
+	struct ecall_direct_entry *d;
+	struct sbi_ecall_extension *t;
+	unsigned long i, id;
+
+	sbi_memset(ecall_direct, 0, sizeof(ecall_direct));
+	ecall_sorted_count = 0;
+
+	sbi_list_for_each_entry(t, &ecall_exts_list, head) {
+		if (ECALL_SORTED_MAX <= ecall_sorted_count)
+			return;
+
+		/* Insertion sort, extension ranges never overlap */
+		i = ecall_sorted_count++;
+		while (i && t->extid_start < ecall_sorted[i - 1]->extid_start) {
+			ecall_sorted[i] = ecall_sorted[i - 1];
+			i--;
+		}
+		ecall_sorted[i] = t;
+
+		if (ECALL_DIRECT_RANGE_MAX <= t->extid_end - t->extid_start)
+			continue;
+		for (id = t->extid_start; id <= t->extid_end; id++) {
+			/* Colliding IDs are left to the binary search */
+			d = &ecall_direct[ecall_direct_hash(id)];
+			if (!d->ext) {
+				d->extid = id;
+				d->ext = t;
+			}
+		}
+	}
+
+	ecall_lookup_gen++;
+	smp_wmb();
+	ecall_lookup_ready = true;
+}
+
+struct sbi_ecall_extension *sbi_ecall_find_extension(unsigned long extid)
+{
+	struct ecall_direct_entry *d;
+	struct ecall_last_hit *hit;
+	struct sbi_ecall_extension *ret;
+
+	if (!ecall_lookup_ready)
+		return ecall_list_find(extid);
+
+	hit = sbi_scratch_thishart_offset_ptr(ecall_last_hit_off);
+	if (hit->ext && hit->gen == ecall_lookup_gen && hit->extid == extid)
+		return hit->ext;
+
+	d = &ecall_direct[ecall_direct_hash(extid)];
+	if (d->ext && d->extid == extid)
+		ret = d->ext;
+	else
+		ret = ecall_sorted_find(extid);
+
+	if (ret) {
+		hit->gen = ecall_lookup_gen;
+		hit->extid = extid;
+		hit->ext = ret;
+	}
+
+	return ret;
+}
+
 int sbi_ecall_register_extension(struct sbi_ecall_extension *ext)
 {
+	bool rebuild = ecall_lookup_ready;
 	struct sbi_ecall_extension *t;
 
 	if (!ext || (ext->extid_end < ext->extid_start) || !ext->handle)
@@ -70,8 +204,12 @@ int sbi_ecall_register_extension(struct sbi_ecall_extension *ext)
 			return SBI_EINVAL;
 	}
 
+	/* Fall back to the list until the lookup is rebuilt */
+	ecall_lookup_ready = false;
 	SBI_INIT_LIST_HEAD(&ext->head);
 	sbi_list_add_tail(&ext->head, &ecall_exts_list);
+	if (rebuild)
+		ecall_lookup_build();
 
 	return 0;
 }
@@ -91,10 +229,286 @@ void sbi_ecall_unregister_extension(struct sbi_ecall_extension *ext)
 		}
 	}
 
-	if (found)
+	if (found) {
+		bool rebuild = ecall_lookup_ready;
+
+		ecall_lookup_ready = false;
 		sbi_list_del_init(&ext->head);
+		if (rebuild)
+			ecall_lookup_build();
+	}
+}
+
+#ifdef CONFIG_SBI_ECALL_STATS
+
+/*
+ * Per-HART latency histograms. Slots are assigned to (extid, funcid)
+ * pairs on first use and the extra last slot accounts all SBI functions
+ * which did not get a slot. Only the owning HART updates its table.
+ */
+struct ecall_stats {
+	unsigned long used;
+	struct sbi_ecall_stats_entry slots[SBI_ECALL_STATS_SLOTS + 1];
+};
+
+_Static_assert(sizeof(struct ecall_stats) <= SBI_ECALL_STATS_HEAP_SIZE,
+	       "SBI_ECALL_STATS_HEAP_SIZE is too small for ecall_stats");
+
+static unsigned long ecall_stats_ptr_off;
+
+#define ecall_stats_get(__scratch)					\
+	sbi_scratch_read_type((__scratch), struct ecall_stats *,	\
+			      ecall_stats_ptr_off)
+
+static inline unsigned long ecall_stats_start(void)
+{
+	return csr_read(CSR_MCYCLE);
+}
+
+static struct sbi_ecall_stats_entry *ecall_stats_slot(struct ecall_stats *st,
+						      unsigned long extid,
+						      unsigned long funcid)
+{
+	struct sbi_ecall_stats_entry *e;
+	unsigned long i, s;
+
+	s = (extid ^ (extid >> 16) ^ funcid) % SBI_ECALL_STATS_SLOTS;
+	for (i = 0; i < SBI_ECALL_STATS_SLOTS; i++) {
+		e = &st->slots[s];
+		if (!(st->used & BIT(s))) {
+			st->used |= BIT(s);
+			e->extid = extid;
+			e->funcid = funcid;
+			return e;
+		}
+		if (e->extid == extid && e->funcid == funcid)
+			return e;
+		s = (s + 1) % SBI_ECALL_STATS_SLOTS;
+	}
+
+	return &st->slots[SBI_ECALL_STATS_SLOTS];
+}
+
+static void ecall_stats_record(unsigned long extid, unsigned long funcid,
+			       unsigned long start)
+{
+	unsigned long cycles = csr_read(CSR_MCYCLE) - start;
+	struct ecall_stats *st;
+	unsigned long b;
+
+	st = ecall_stats_get(sbi_scratch_thishart_ptr());
+	if (!st)
+		return;
+
+	cycles >>= SBI_ECALL_STATS_BUCKET_SHIFT;
+	b = cycles ? sbi_fls(cycles) + 1 : 0;
+	if (SBI_ECALL_STATS_BUCKETS <= b)
+		b = SBI_ECALL_STATS_BUCKETS - 1;
+
+	ecall_stats_slot(st, extid, funcid)->hist[b]++;
+}
+
+static bool ecall_stats_entry_used(struct ecall_stats *st, unsigned long i)
+{
+	unsigned long b;
+
+	if (i < SBI_ECALL_STATS_SLOTS)
+		return (st->used & BIT(i)) ? true : false;
+
+	for (b = 0; b < SBI_ECALL_STATS_BUCKETS; b++) {
+		if (st->slots[i].hist[b])
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Copy a snapshot of the SBI call latency histograms of a HART
+ * @param hartindex the HART index
+ * @param buf destination array of struct sbi_ecall_stats_entry (may be
+ * unaligned)
+ * @param count number of entries available in the destination
+ * @return number of entries copied or SBI_Exxx (< 0) on failure
+ */
+int sbi_ecall_stats_read(u32 hartindex, void *buf, unsigned long count)
+{
+	struct sbi_scratch *scratch = sbi_hartindex_to_scratch(hartindex);
+	struct sbi_ecall_stats_entry *dst = buf;
+	struct ecall_stats *st;
+	unsigned long i, n = 0;
+
+	if (!scratch || !ecall_stats_ptr_off)
+		return SBI_EINVAL;
+	st = ecall_stats_get(scratch);
+	if (!st)
+		return SBI_ENOTSUPP;
+
+	for (i = 0; i <= SBI_ECALL_STATS_SLOTS && n < count; i++) {
+		if (!ecall_stats_entry_used(st, i))
+			continue;
+		sbi_memcpy(&dst[n], &st->slots[i], sizeof(*dst));
+		n++;
+	}
+
+	return n;
+}
+
+void sbi_ecall_stats_dump(void)
+{
+	struct sbi_ecall_stats_entry *e;
+	struct sbi_scratch *scratch;
+	struct ecall_stats *st;
+	u32 h, i, b;
+
+	if (!ecall_stats_ptr_off)
+		return;
+
+	sbi_printf("SBI call latency in cycles, bucket i < 2^(%d+i):\n",
+		   SBI_ECALL_STATS_BUCKET_SHIFT);
+	for (h = 0; h <= sbi_scratch_last_hartindex(); h++) {
+		scratch = sbi_hartindex_to_scratch(h);
+		st = scratch ? ecall_stats_get(scratch) : NULL;
+		if (!st)
+			continue;
+
+		for (i = 0; i <= SBI_ECALL_STATS_SLOTS; i++) {
+			if (!ecall_stats_entry_used(st, i))
+				continue;
+			e = &st->slots[i];
+			sbi_printf("hart%u ext 0x%lx fid 0x%lx:",
+				   sbi_hartindex_to_hartid(h),
+				   e->extid, e->funcid);
+			for (b = 0; b < SBI_ECALL_STATS_BUCKETS; b++)
+				sbi_printf(" %u", e->hist[b]);
+			sbi_printf("\n");
+		}
+	}
+}
+
+static int ecall_stats_init(void)
+{
+	struct sbi_scratch *scratch;
+	struct ecall_stats *st;
+	u32 i;
+
+	ecall_stats_ptr_off = sbi_scratch_alloc_type_offset(void *);
+	if (!ecall_stats_ptr_off)
+		return SBI_ENOMEM;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		scratch = sbi_hartindex_to_scratch(i);
+		if (!scratch)
+			continue;
+
+		st = sbi_zalloc(sizeof(*st));
+		if (!st)
+			return SBI_ENOMEM;
+		sbi_scratch_write_type(scratch, void *, ecall_stats_ptr_off, st);
+	}
+
+	return 0;
+}
+
+#else
+
+static inline unsigned long ecall_stats_start(void)
+{
+	return 0;
+}
+
+static inline void ecall_stats_record(unsigned long extid,
+				      unsigned long funcid,
+				      unsigned long start)
+{
+}
+
+static inline int ecall_stats_init(void)
+{
+	return 0;
 }
 
+#endif
+
+#ifdef CONFIG_SBI_ECALL_FAST_PATH
+
+#define ECALL_FAST_MAX			4
+
+struct ecall_fast_entry {
+	unsigned long extid;
+	unsigned long funcid;
+	int (*handle)(unsigned long a0, unsigned long a1,
+		      unsigned long *out_val);
+};
+
+struct ecall_fast_ret {
+	long error;
+	unsigned long value;
+};
+
+static struct ecall_fast_entry ecall_fast[ECALL_FAST_MAX];
+static unsigned long ecall_fast_count;
+
+/**
+ * Register a leaf handler for the SBI call fast path
+ *
+ * The handler is called from the trap entry with only the caller-saved
+ * registers saved so it must not trap and must not depend on the trap
+ * context. It returns an SBI error code, or SBI_ECALL_FAST_FALLBACK to
+ * let the call take the regular trap path.
+ */
+int sbi_ecall_register_fast(unsigned long extid, unsigned long funcid,
+			    int (*handle)(unsigned long a0, unsigned long a1,
+					  unsigned long *out_val))
+{
+	struct ecall_fast_entry *e;
+
+	if (!handle)
+		return SBI_EINVAL;
+	if (ECALL_FAST_MAX <= ecall_fast_count)
+		return SBI_ENOSPC;
+
+	e = &ecall_fast[ecall_fast_count];
+	e->extid = extid;
+	e->funcid = funcid;
+	e->handle = handle;
+	ecall_fast_count++;
+
+	return 0;
+}
+
+/* Called from the trap entry of fw_base.S for ecalls from S-mode */
+struct ecall_fast_ret sbi_ecall_fast_handler(unsigned long a0,
+					     unsigned long a1,
+					     unsigned long a2,
+					     unsigned long a3,
+					     unsigned long a4,
+					     unsigned long a5,
+					     unsigned long funcid,
+					     unsigned long extid)
+{
+	struct ecall_fast_ret ret = { .error = SBI_ECALL_FAST_FALLBACK };
+	unsigned long i, start = ecall_stats_start();
+
+	for (i = 0; i < ecall_fast_count; i++) {
+		if (ecall_fast[i].extid == extid &&
+		    ecall_fast[i].funcid == funcid) {
+			ret.error = ecall_fast[i].handle(a0, a1, &ret.value);
+			break;
+		}
+	}
+
+	/* Calls falling back are accounted on the regular trap path */
+	if (ret.error != SBI_ECALL_FAST_FALLBACK) {
+		sbi_trap_stats_exception(CAUSE_SUPERVISOR_ECALL);
+		ecall_stats_record(extid, funcid, start);
+	}
+
+	return ret;
+}
+
+#endif
+
 int sbi_ecall_handler(struct sbi_trap_context *tcntx)
 {
 	int ret = 0;
@@ -104,6 +518,7 @@ int sbi_ecall_handler(struct sbi_trap_context *tcntx)
 	unsigned long func_id = regs->a6;
 	struct sbi_ecall_return out = {0};
 	bool is_0_1_spec = 0;
+	unsigned long start = ecall_stats_start();
 
 	ext = sbi_ecall_find_extension(extension_id);
 	if (ext && ext->handle) {
@@ -139,6 +554,8 @@ int sbi_ecall_handler(struct sbi_trap_context *tcntx)
 			regs->a1 = out.value;
 	}
 
+	ecall_stats_record(extension_id, func_id, start);
+
 	return 0;
 }
 
@@ -158,5 +575,15 @@ int sbi_ecall_init(void)
 			return ret;
 	}
 
+	ecall_last_hit_off = sbi_scratch_alloc_type_offset(struct ecall_last_hit);
+	if (!ecall_last_hit_off)
+		return SBI_ENOMEM;
+
+	ret = ecall_stats_init();
+	if (ret)
+		return ret;
+
+	ecall_lookup_build();
+
 	return 0;
 }
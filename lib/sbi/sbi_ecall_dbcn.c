@@ -16,6 +16,47 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_hart.h>
 
+/* Console data is bounced through the stack in chunks of this size */
+#define DBCN_CHUNK_SIZE		128
+
+static unsigned long sbi_ecall_dbcn_write(unsigned long addr,
+					  unsigned long len)
+{
+	char buf[DBCN_CHUNK_SIZE];
+	unsigned long n, done, total = 0;
+
+	while (total < len) {
+		n = MIN(len - total, sizeof(buf));
+		if (sbi_hart_copy_from_saddr(buf, addr + total, n))
+			break;
+		done = sbi_nputs(buf, n);
+		total += done;
+		if (done < n)
+			break;
+	}
+
+	return total;
+}
+
+static unsigned long sbi_ecall_dbcn_read(unsigned long addr,
+					 unsigned long len)
+{
+	char buf[DBCN_CHUNK_SIZE];
+	unsigned long n, done, total = 0;
+
+	while (total < len) {
+		n = MIN(len - total, sizeof(buf));
+		done = sbi_ngets(buf, n);
+		if (!done || sbi_hart_copy_to_saddr(addr + total, buf, done))
+			break;
+		total += done;
+		if (done < n)
+			break;
+	}
+
+	return total;
+}
+
 static int sbi_ecall_dbcn_handler(unsigned long extid, unsigned long funcid,
 				  struct sbi_trap_regs *regs,
 				  struct sbi_ecall_return *out)
@@ -46,12 +87,10 @@ static int sbi_ecall_dbcn_handler(unsigned long extid, unsigned long funcid,
 					regs->a1, regs->a0, smode,
 					SBI_DOMAIN_READ|SBI_DOMAIN_WRITE))
 			return SBI_ERR_INVALID_PARAM;
-		sbi_hart_map_saddr(regs->a1, regs->a0);
 		if (funcid == SBI_EXT_DBCN_CONSOLE_WRITE)
-			out->value = sbi_nputs((const char *)regs->a1, regs->a0);
+			out->value = sbi_ecall_dbcn_write(regs->a1, regs->a0);
 		else
-			out->value = sbi_ngets((char *)regs->a1, regs->a0);
-		sbi_hart_unmap_saddr();
+			out->value = sbi_ecall_dbcn_read(regs->a1, regs->a0);
 		return 0;
 	case SBI_EXT_DBCN_CONSOLE_WRITE_BYTE:
 		sbi_putc(regs->a0);
@@ -30,8 +30,8 @@ static bool sbi_load_hart_mask_unpriv(ulong *pmask, ulong *hmask,
 	ulong mask = 0;
 
 	if (pmask) {
-		mask = sbi_load_ulong(pmask, uptrap);
-		if (uptrap->cause)
+		if (sbi_copy_from_lower(&mask, pmask, sizeof(mask),
+					uptrap) != sizeof(mask))
 			return false;
 	} else {
 		sbi_hsm_hart_interruptible_mask(sbi_domain_thishart_ptr(),
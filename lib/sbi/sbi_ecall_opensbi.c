@@ -0,0 +1,256 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * OpenSBI firmware specific SBI extension
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall.h>
+#include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
+#include <sbi/sbi_tlb.h>
+#include <sbi/sbi_trap.h>
+
+static int sbi_ecall_opensbi_stats(struct sbi_trap_regs *regs,
+				   struct sbi_ecall_return *out)
+{
+	ulong smode = (csr_read(CSR_MSTATUS) & MSTATUS_MPP) >>
+			MSTATUS_MPP_SHIFT;
+	struct sbi_domain *dom = sbi_domain_thishart_ptr();
+	unsigned long count, size;
+	int ret;
+
+	/*
+	 * a0: HART ID, a1: size of the shared memory in bytes,
+	 * a2/a3: lower/upper bits of the shared memory physical address.
+	 * As for the DBCN extension, the upper bits must be zero.
+	 */
+	if (regs->a3)
+		return SBI_ERR_FAILED;
+	if (!sbi_domain_is_assigned_hart(dom, regs->a0))
+		return SBI_ERR_INVALID_PARAM;
+
+	count = regs->a1 / sizeof(struct sbi_ecall_stats_entry);
+	if (!count)
+		return SBI_ERR_INVALID_PARAM;
+
+	/* Only check and map the entries which may be written */
+	count = MIN(count, SBI_ECALL_STATS_SLOTS + 1);
+	size = count * sizeof(struct sbi_ecall_stats_entry);
+	if (!sbi_domain_check_addr_range(dom, regs->a2, size, smode,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_ERR_INVALID_ADDRESS;
+
+	ret = sbi_hart_map_saddr(regs->a2, size);
+	if (ret)
+		return ret;
+	ret = sbi_ecall_stats_read(sbi_hartid_to_hartindex(regs->a0),
+				   (void *)regs->a2, count);
+	sbi_hart_unmap_saddr();
+	if (ret < 0)
+		return ret;
+
+	out->value = ret;
+	return 0;
+}
+
+static int sbi_ecall_opensbi_heap_stats(struct sbi_trap_regs *regs,
+					struct sbi_ecall_return *out)
+{
+	ulong smode = (csr_read(CSR_MSTATUS) & MSTATUS_MPP) >>
+			MSTATUS_MPP_SHIFT;
+	struct sbi_heap_stats st;
+	int ret;
+
+	/*
+	 * a0: size of the shared memory in bytes, a1/a2: lower/upper bits
+	 * of the shared memory physical address. The upper bits must be
+	 * zero.
+	 */
+	if (regs->a2)
+		return SBI_ERR_FAILED;
+	if (regs->a0 < sizeof(st))
+		return SBI_ERR_INVALID_PARAM;
+
+	ret = sbi_heap_stats_read(&st);
+	if (ret)
+		return ret;
+
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 regs->a1, sizeof(st), smode,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_ERR_INVALID_ADDRESS;
+
+	ret = sbi_hart_copy_to_saddr(regs->a1, &st, sizeof(st));
+	if (ret)
+		return ret;
+
+	out->value = sizeof(st);
+	return 0;
+}
+
+/*
+ * SBI calls which may not return to the caller, change the trap frame
+ * beyond a0/a1 or set up shared memory are not allowed in a multicall.
+ * PMU counter start/stop may still access the snapshot area which the
+ * caller registered earlier.
+ */
+static bool sbi_ecall_opensbi_multicall_allowed(unsigned long extid,
+						unsigned long funcid)
+{
+	switch (extid) {
+	case SBI_EXT_BASE:
+	case SBI_EXT_TIME:
+	case SBI_EXT_IPI:
+	case SBI_EXT_RFENCE:
+		return true;
+	case SBI_EXT_PMU:
+		switch (funcid) {
+		case SBI_EXT_PMU_NUM_COUNTERS:
+		case SBI_EXT_PMU_COUNTER_GET_INFO:
+		case SBI_EXT_PMU_COUNTER_START:
+		case SBI_EXT_PMU_COUNTER_STOP:
+		case SBI_EXT_PMU_COUNTER_FW_READ:
+		case SBI_EXT_PMU_COUNTER_FW_READ_HI:
+			return true;
+		default:
+			return false;
+		}
+	default:
+		return false;
+	}
+}
+
+static void sbi_ecall_opensbi_multicall_one(struct sbi_trap_regs *regs,
+					    struct sbi_multicall_entry *e)
+{
+	struct sbi_ecall_extension *ext;
+	struct sbi_ecall_return out = {0};
+	struct sbi_trap_regs sub;
+	int ret;
+
+	ext = sbi_ecall_find_extension(e->extid);
+	if (!ext || !ext->handle ||
+	    !sbi_ecall_opensbi_multicall_allowed(e->extid, e->funcid)) {
+		e->error = SBI_ERR_NOT_SUPPORTED;
+		e->value = 0;
+		return;
+	}
+
+	/* Run the call on a copy of the trap frame of the multicall */
+	sbi_memcpy(&sub, regs, sizeof(sub));
+	sub.a0 = e->args[0];
+	sub.a1 = e->args[1];
+	sub.a2 = e->args[2];
+	sub.a3 = e->args[3];
+	sub.a4 = e->args[4];
+	sub.a5 = e->args[5];
+	sub.a6 = e->funcid;
+	sub.a7 = e->extid;
+
+	ret = ext->handle(e->extid, e->funcid, &sub, &out);
+	if (ret < SBI_LAST_ERR || SBI_SUCCESS < ret)
+		ret = SBI_ERR_FAILED;
+
+	e->error = ret;
+	e->value = out.value;
+}
+
+static int sbi_ecall_opensbi_multicall(struct sbi_trap_regs *regs,
+				       struct sbi_ecall_return *out)
+{
+	ulong smode = (csr_read(CSR_MSTATUS) & MSTATUS_MPP) >>
+			MSTATUS_MPP_SHIFT;
+	struct sbi_multicall_entry e;
+	unsigned long i, addr, size;
+
+	/*
+	 * a0: number of entries, a1/a2: lower/upper bits of the physical
+	 * address of the entry array. The upper bits must be zero.
+	 */
+	if (regs->a2)
+		return SBI_ERR_FAILED;
+	if (!regs->a0 || SBI_MULTICALL_MAX < regs->a0)
+		return SBI_ERR_INVALID_PARAM;
+
+	size = regs->a0 * sizeof(e);
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(),
+					 regs->a1, size, smode,
+					 SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_ERR_INVALID_ADDRESS;
+
+	/*
+	 * Each entry is copied in and out separately so that the shared
+	 * memory is not mapped while the SBI calls are executed.
+	 */
+	for (i = 0; i < regs->a0; i++) {
+		addr = regs->a1 + i * sizeof(e);
+
+		sbi_hart_map_saddr(addr, sizeof(e));
+		sbi_memcpy(&e, (void *)addr, sizeof(e));
+		sbi_hart_unmap_saddr();
+
+		sbi_ecall_opensbi_multicall_one(regs, &e);
+
+		sbi_hart_map_saddr(addr, sizeof(e));
+		sbi_memcpy((void *)addr, &e, sizeof(e));
+		sbi_hart_unmap_saddr();
+	}
+
+	out->value = i;
+	return 0;
+}
+
+static int sbi_ecall_opensbi_rfence_ring(struct sbi_trap_regs *regs)
+{
+	/*
+	 * a0: number of ring entries (zero to disable the ring),
+	 * a1/a2: lower/upper bits of the physical address of the ring.
+	 * The upper bits must be zero.
+	 */
+	if (regs->a2)
+		return SBI_ERR_FAILED;
+
+	return sbi_tlb_async_setup(regs->a0, regs->a1);
+}
+
+static int sbi_ecall_opensbi_handler(unsigned long extid, unsigned long funcid,
+				     struct sbi_trap_regs *regs,
+				     struct sbi_ecall_return *out)
+{
+	switch (funcid) {
+	case SBI_EXT_OPENSBI_ECALL_STATS:
+		return sbi_ecall_opensbi_stats(regs, out);
+	case SBI_EXT_OPENSBI_MULTICALL:
+		return sbi_ecall_opensbi_multicall(regs, out);
+	case SBI_EXT_OPENSBI_RFENCE_RING_SETUP:
+		return sbi_ecall_opensbi_rfence_ring(regs);
+	case SBI_EXT_OPENSBI_RFENCE_RING_DOORBELL:
+		return sbi_tlb_async_doorbell();
+	case SBI_EXT_OPENSBI_HEAP_STATS:
+		return sbi_ecall_opensbi_heap_stats(regs, out);
+	default:
+		break;
+	}
+
+	return SBI_ENOTSUPP;
+}
+
+struct sbi_ecall_extension ecall_opensbi;
+
+static int sbi_ecall_opensbi_register_extensions(void)
+{
+	return sbi_ecall_register_extension(&ecall_opensbi);
+}
+
+struct sbi_ecall_extension ecall_opensbi = {
+	.extid_start		= SBI_EXT_OPENSBI,
+	.extid_end		= SBI_EXT_OPENSBI,
+	.register_extensions	= sbi_ecall_opensbi_register_extensions,
+	.handle			= sbi_ecall_opensbi_handler,
+};
@@ -82,10 +82,50 @@ static int sbi_ecall_pmu_handler(unsigned long extid, unsigned long funcid,
 	return ret;
 }
 
+static int sbi_ecall_pmu_fast_fw_read(unsigned long a0, unsigned long a1,
+				      unsigned long *out_val)
+{
+	uint64_t temp = 0;
+	int ret;
+
+	ret = sbi_pmu_ctr_fw_read(a0, &temp);
+	*out_val = temp;
+
+	return ret;
+}
+
+#if __riscv_xlen == 32
+static int sbi_ecall_pmu_fast_fw_read_hi(unsigned long a0, unsigned long a1,
+					 unsigned long *out_val)
+{
+	uint64_t temp = 0;
+	int ret;
+
+	ret = sbi_pmu_ctr_fw_read(a0, &temp);
+	*out_val = temp >> 32;
+
+	return ret;
+}
+#endif
+
 struct sbi_ecall_extension ecall_pmu;
 
 static int sbi_ecall_pmu_register_extensions(void)
 {
+	int rc;
+
+	rc = sbi_ecall_register_fast(SBI_EXT_PMU, SBI_EXT_PMU_COUNTER_FW_READ,
+				     sbi_ecall_pmu_fast_fw_read);
+	if (rc)
+		return rc;
+#if __riscv_xlen == 32
+	rc = sbi_ecall_register_fast(SBI_EXT_PMU,
+				     SBI_EXT_PMU_COUNTER_FW_READ_HI,
+				     sbi_ecall_pmu_fast_fw_read_hi);
+	if (rc)
+		return rc;
+#endif
+
 	return sbi_ecall_register_extension(&ecall_pmu);
 }
 
@@ -8,7 +8,6 @@
  *   Atish Patra <atish.patra@wdc.com>
  */
 
-#include <sbi/riscv_asm.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
@@ -19,61 +18,15 @@ static int sbi_ecall_rfence_handler(unsigned long extid, unsigned long funcid,
 				    struct sbi_trap_regs *regs,
 				    struct sbi_ecall_return *out)
 {
-	int ret = 0;
-	unsigned long vmid;
+	int ret;
 	struct sbi_tlb_info tlb_info;
-	u32 source_hart = current_hartid();
 
-	if (funcid >= SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA_VMID &&
-	    funcid <= SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA)
-		if (!misa_extension('H'))
-			return SBI_ENOTSUPP;
+	ret = sbi_tlb_rfence_info_init(&tlb_info, funcid,
+				       regs->a2, regs->a3, regs->a4);
+	if (ret)
+		return ret;
 
-	switch (funcid) {
-	case SBI_EXT_RFENCE_REMOTE_FENCE_I:
-		SBI_TLB_INFO_INIT(&tlb_info, 0, 0, 0, 0,
-				  SBI_TLB_FENCE_I, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
-		break;
-	case SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA:
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, 0, 0,
-				  SBI_TLB_HFENCE_GVMA, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
-		break;
-	case SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA_VMID:
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, 0, regs->a4,
-				  SBI_TLB_HFENCE_GVMA_VMID, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
-		break;
-	case SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA:
-		vmid = (csr_read(CSR_HGATP) & HGATP_VMID_MASK);
-		vmid = vmid >> HGATP_VMID_SHIFT;
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, 0, vmid,
-				  SBI_TLB_HFENCE_VVMA, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
-		break;
-	case SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA_ASID:
-		vmid = (csr_read(CSR_HGATP) & HGATP_VMID_MASK);
-		vmid = vmid >> HGATP_VMID_SHIFT;
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, regs->a4,
-				  vmid, SBI_TLB_HFENCE_VVMA_ASID, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
-		break;
-	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA:
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, 0, 0,
-				  SBI_TLB_SFENCE_VMA, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
-		break;
-	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA_ASID:
-		SBI_TLB_INFO_INIT(&tlb_info, regs->a2, regs->a3, regs->a4, 0,
-				  SBI_TLB_SFENCE_VMA_ASID, source_hart);
-		ret = sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
-		break;
-	default:
-		ret = SBI_ENOTSUPP;
-	}
-
-	return ret;
+	return sbi_tlb_request(regs->a0, regs->a1, &tlb_info);
 }
 
 struct sbi_ecall_extension ecall_rfence;
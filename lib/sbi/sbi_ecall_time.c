@@ -11,6 +11,8 @@
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_ecall.h>
 #include <sbi/sbi_ecall_interface.h>
+#include <sbi/sbi_hart.h>
+#include <sbi/sbi_scratch.h>
 #include <sbi/sbi_trap.h>
 #include <sbi/sbi_timer.h>
 
@@ -32,10 +34,34 @@ static int sbi_ecall_time_handler(unsigned long extid, unsigned long funcid,
 	return ret;
 }
 
+static int sbi_ecall_time_fast_set_timer(unsigned long a0, unsigned long a1,
+					 unsigned long *out_val)
+{
+	/* Programming a timer device is left to the regular path */
+	if (!sbi_hart_has_extension(sbi_scratch_thishart_ptr(),
+				    SBI_HART_EXT_SSTC))
+		return SBI_ECALL_FAST_FALLBACK;
+
+#if __riscv_xlen == 32
+	sbi_timer_event_start((((u64)a1 << 32) | (u64)a0));
+#else
+	sbi_timer_event_start((u64)a0);
+#endif
+
+	return 0;
+}
+
 struct sbi_ecall_extension ecall_time;
 
 static int sbi_ecall_time_register_extensions(void)
 {
+	int rc;
+
+	rc = sbi_ecall_register_fast(SBI_EXT_TIME, SBI_EXT_TIME_SET_TIMER,
+				     sbi_ecall_time_fast_set_timer);
+	if (rc)
+		return rc;
+
 	return sbi_ecall_register_extension(&ecall_time);
 }
 
@@ -529,6 +529,51 @@ int sbi_hart_unmap_saddr(void)
 	return pmp_disable(SBI_SMEPMP_RESV_ENTRY);
 }
 
+static void hart_copy_saddr(void *dst, const void *src, unsigned long size)
+{
+	unsigned long i;
+
+	/* sbi_memcpy() copies byte per byte so copy words when possible */
+	if (((unsigned long)dst | (unsigned long)src | size) &
+	    (sizeof(unsigned long) - 1)) {
+		sbi_memcpy(dst, src, size);
+		return;
+	}
+
+	for (i = 0; i < size / sizeof(unsigned long); i++)
+		((unsigned long *)dst)[i] = ((const unsigned long *)src)[i];
+}
+
+/*
+ * Copy from/to shared memory of S/U-mode at a physical address which has
+ * been checked against the domain of the calling HART. The shared memory
+ * is mapped only for the duration of the copy.
+ */
+int sbi_hart_copy_from_saddr(void *dst, unsigned long addr, unsigned long size)
+{
+	int rc;
+
+	rc = sbi_hart_map_saddr(addr, size);
+	if (rc)
+		return rc;
+	hart_copy_saddr(dst, (const void *)addr, size);
+
+	return sbi_hart_unmap_saddr();
+}
+
+int sbi_hart_copy_to_saddr(unsigned long addr, const void *src,
+			   unsigned long size)
+{
+	int rc;
+
+	rc = sbi_hart_map_saddr(addr, size);
+	if (rc)
+		return rc;
+	hart_copy_saddr((void *)addr, src, size);
+
+	return sbi_hart_unmap_saddr();
+}
+
 int sbi_hart_pmp_configure(struct sbi_scratch *scratch)
 {
 	int rc;
@@ -680,6 +725,8 @@ const struct sbi_hart_ext_data sbi_hart_ext[] = {
 	__SBI_HART_EXT_DATA(ssccfg, SBI_HART_EXT_SSCCFG),
 	__SBI_HART_EXT_DATA(svade, SBI_HART_EXT_SVADE),
 	__SBI_HART_EXT_DATA(svadu, SBI_HART_EXT_SVADU),
+	__SBI_HART_EXT_DATA(svinval, SBI_HART_EXT_SVINVAL),
+	__SBI_HART_EXT_DATA(zawrs, SBI_HART_EXT_ZAWRS),
 };
 
 _Static_assert(SBI_HART_EXT_MAX == array_size(sbi_hart_ext),
@@ -768,6 +815,29 @@ static int hart_mhpm_get_allowed_bits(void)
 	return num_bits;
 }
 
+static bool hart_svinval_allowed(void)
+{
+	struct sbi_trap_info trap = {0};
+	register ulong tinfo asm("a3") = (ulong)&trap;
+	register ulong ttmp asm("a4");
+	register ulong mtvec = sbi_hart_expected_trap_addr();
+
+	/*
+	 * SFENCE.W.INVAL is harmless in M-mode and raises an illegal
+	 * instruction trap when Svinval is not implemented.
+	 */
+	asm volatile(
+		"add %[ttmp], %[tinfo], zero\n"
+		"csrrw %[mtvec], " STR(CSR_MTVEC) ", %[mtvec]\n"
+		".word 0x18000073\n"
+		"csrw " STR(CSR_MTVEC) ", %[mtvec]"
+	    : [mtvec] "+&r"(mtvec), [tinfo] "+&r"(tinfo), [ttmp] "+&r"(ttmp)
+	    :
+	    : "memory");
+
+	return trap.cause ? false : true;
+}
+
 static int hart_detect_features(struct sbi_scratch *scratch)
 {
 	struct sbi_trap_info trap = {0};
@@ -930,6 +1000,11 @@ __pmp_skip:
 
 #undef __check_ext_csr
 
+	/* Detect if hart supports Svinval */
+	if (hart_svinval_allowed())
+		__sbi_hart_update_extension(hfeatures,
+					SBI_HART_EXT_SVINVAL, true);
+
 	/* Save trap based detection of Zicntr */
 	has_zicntr = sbi_hart_has_extension(scratch, SBI_HART_EXT_ZICNTR);
 
@@ -8,20 +8,54 @@
  */
 
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_console.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_heap.h>
 #include <sbi/sbi_list.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_string.h>
 
+/* The heap defines the functions hidden by the call site wrappers */
+#undef sbi_malloc
+#undef sbi_zalloc
+
+/*
+ * Every block of the heap, free or used, is described by a boundary tag
+ * holding its size in granules of HEAP_ALLOC_ALIGN bytes and whether it
+ * is free. The tags live in a table in the housekeeping area with one
+ * entry per granule but only the first and the last granule of each
+ * block carry its tag, all other entries are zero. The tag of the first
+ * granule is marked as such, so a pointer into a block is never taken
+ * for the block itself. This gives the size of a block from its address
+ * and the state of both of its neighbours in constant time. Free blocks
+ * are linked into the free space list through a list head stored in the
+ * block itself.
+ */
+
 /* Minimum size and alignment of heap allocations */
 #define HEAP_ALLOC_ALIGN		64
-#define HEAP_HOUSEKEEPING_FACTOR	16
 
-struct heap_node {
+#define HEAP_TAG_FREE			0x8000
+#define HEAP_TAG_START			0x4000
+#define HEAP_TAG_MAX_GRANULES		0x3fff
+#define HEAP_BLOCK_MAX_SIZE		(HEAP_TAG_MAX_GRANULES * HEAP_ALLOC_ALIGN)
+
+#ifdef CONFIG_SBI_HEAP_SIZE_CLASSES
+/* Allocations of up to 512 bytes are served from size class free lists */
+#define HEAP_CLASS_COUNT		4
+#define HEAP_CLASS_MAX_SIZE		(HEAP_ALLOC_ALIGN << (HEAP_CLASS_COUNT - 1))
+/* Blocks of a size class are carved from naturally aligned slabs */
+#define HEAP_SLAB_SIZE			HEAP_BASE_ALIGN
+#else
+#define HEAP_CLASS_MAX_SIZE		0
+#endif
+
+struct heap_free_block {
 	struct sbi_dlist head;
-	unsigned long addr;
-	unsigned long size;
+};
+
+struct heap_block {
+	struct heap_block *next;
 };
 
 struct heap_control {
@@ -30,124 +64,745 @@ struct heap_control {
 	unsigned long size;
 	unsigned long hkbase;
 	unsigned long hksize;
-	struct sbi_dlist free_node_list;
 	struct sbi_dlist free_space_list;
-	struct sbi_dlist used_space_list;
+	/** Amount of free space in the free space list */
+	unsigned long free_size;
+	/** Boundary tag of each granule of the heap */
+	u16 *tags;
+#ifdef CONFIG_SBI_HEAP_SIZE_CLASSES
+	/** Size class plus one of each slab in the heap, zero if not a slab */
+	u8 *slab_class;
+	struct heap_block *class_free[HEAP_CLASS_COUNT];
+	/** Amount of free space held by the size class free lists */
+	unsigned long class_free_size;
+#endif
 };
 
 static struct heap_control hpctrl;
 
-void *sbi_malloc(size_t size)
+static inline u16 *heap_tag(unsigned long addr)
 {
-	void *ret = NULL;
-	struct heap_node *n, *np;
+	return &hpctrl.tags[(addr - hpctrl.base) / HEAP_ALLOC_ALIGN];
+}
 
-	if (!size)
-		return NULL;
+static inline unsigned long heap_tag_size(u16 tag)
+{
+	return (unsigned long)(tag & HEAP_TAG_MAX_GRANULES) * HEAP_ALLOC_ALIGN;
+}
 
-	size += HEAP_ALLOC_ALIGN - 1;
-	size &= ~((unsigned long)HEAP_ALLOC_ALIGN - 1);
+static void heap_set_block(unsigned long addr, unsigned long size, bool free)
+{
+	u16 tag = (size / HEAP_ALLOC_ALIGN) | ((free) ? HEAP_TAG_FREE : 0);
 
-	spin_lock(&hpctrl.lock);
+	*heap_tag(addr + size - HEAP_ALLOC_ALIGN) = tag;
+	*heap_tag(addr) = tag | HEAP_TAG_START;
+}
+
+static inline unsigned long heap_start(void)
+{
+	return hpctrl.hkbase + hpctrl.hksize;
+}
+
+static inline unsigned long heap_end(void)
+{
+	return hpctrl.base + hpctrl.size;
+}
+
+static void heap_add_free_block(unsigned long addr)
+{
+	struct heap_free_block *fb = (struct heap_free_block *)addr;
+
+	SBI_INIT_LIST_HEAD(&fb->head);
+	sbi_list_add_tail(&fb->head, &hpctrl.free_space_list);
+}
+
+/* First-fit allocation from the end of a free block, called with lock held */
+static void *heap_alloc_large(unsigned long size, unsigned long align)
+{
+	unsigned long baddr = 0, bsize, addr = 0, head, tail;
+	struct heap_free_block *fb;
+	bool found = false;
 
-	np = NULL;
-	sbi_list_for_each_entry(n, &hpctrl.free_space_list, head) {
-		if (size <= n->size) {
-			np = n;
+	if (HEAP_BLOCK_MAX_SIZE < size)
+		return NULL;
+
+	sbi_list_for_each_entry(fb, &hpctrl.free_space_list, head) {
+		baddr = (unsigned long)fb;
+		bsize = heap_tag_size(*heap_tag(baddr));
+		if (bsize < size)
+			continue;
+		addr = (baddr + bsize - size) & ~(align - 1);
+		if (baddr <= addr) {
+			found = true;
 			break;
 		}
 	}
-	if (np) {
-		if ((size < np->size) &&
-		    !sbi_list_empty(&hpctrl.free_node_list)) {
-			n = sbi_list_first_entry(&hpctrl.free_node_list,
-						 struct heap_node, head);
-			sbi_list_del(&n->head);
-			n->addr = np->addr + np->size - size;
-			n->size = size;
-			np->size -= size;
-			sbi_list_add_tail(&n->head, &hpctrl.used_space_list);
-			ret = (void *)n->addr;
-		} else if (size == np->size) {
-			sbi_list_del(&np->head);
-			sbi_list_add_tail(&np->head, &hpctrl.used_space_list);
-			ret = (void *)np->addr;
+	if (!found)
+		return NULL;
+
+	head = addr - baddr;
+	tail = baddr + bsize - (addr + size);
+
+	if (head)
+		heap_set_block(baddr, head, true);
+	else
+		sbi_list_del(&fb->head);
+
+	if (tail) {
+		heap_set_block(addr + size, tail, true);
+		heap_add_free_block(addr + size);
+	}
+
+	heap_set_block(addr, size, false);
+	hpctrl.free_size -= size;
+
+	return (void *)addr;
+}
+
+/*
+ * Return a block to the first-fit free space and merge it with the free
+ * blocks right before and after it. Called with lock held.
+ */
+static void heap_free_large(void *ptr)
+{
+	unsigned long addr = (unsigned long)ptr, size, nsize;
+	struct heap_free_block *fb;
+	bool merged = false;
+	u16 tag;
+
+	if (addr < heap_start() || heap_end() <= addr ||
+	    (addr & (HEAP_ALLOC_ALIGN - 1)))
+		return;
+
+	tag = *heap_tag(addr);
+	if (!(tag & HEAP_TAG_START) || (tag & HEAP_TAG_FREE))
+		return;
+	size = heap_tag_size(tag);
+	hpctrl.free_size += size;
+
+	/* Merge with the free block ending right before */
+	if (heap_start() < addr) {
+		tag = *heap_tag(addr - HEAP_ALLOC_ALIGN);
+		nsize = heap_tag_size(tag);
+		if ((tag & HEAP_TAG_FREE) &&
+		    (size + nsize) <= HEAP_BLOCK_MAX_SIZE) {
+			*heap_tag(addr - HEAP_ALLOC_ALIGN) = 0;
+			*heap_tag(addr) = 0;
+			addr -= nsize;
+			size += nsize;
+			merged = true;
+		}
+	}
+
+	/* Merge with the free block starting right after */
+	if ((addr + size) < heap_end()) {
+		tag = *heap_tag(addr + size);
+		nsize = heap_tag_size(tag);
+		if ((tag & HEAP_TAG_FREE) &&
+		    (size + nsize) <= HEAP_BLOCK_MAX_SIZE) {
+			fb = (struct heap_free_block *)(addr + size);
+			sbi_list_del(&fb->head);
+			*heap_tag(addr + size - HEAP_ALLOC_ALIGN) = 0;
+			*heap_tag(addr + size) = 0;
+			size += nsize;
+		}
+	}
+
+	if (!merged)
+		heap_add_free_block(addr);
+	heap_set_block(addr, size, true);
+}
+
+#ifdef CONFIG_SBI_HEAP_SIZE_CLASSES
+
+static inline unsigned long heap_class_size(unsigned long c)
+{
+	return HEAP_ALLOC_ALIGN << c;
+}
+
+static inline unsigned long heap_class_index(unsigned long size)
+{
+	unsigned long c = 0;
+
+	while (heap_class_size(c) < size)
+		c++;
+
+	return c;
+}
+
+/* Size class of the slab holding a block or -1 if not in a slab */
+static inline long heap_slab_class(void *ptr)
+{
+	unsigned long off = (unsigned long)ptr - hpctrl.base;
+
+	if (hpctrl.size <= off)
+		return -1;
+
+	return (long)hpctrl.slab_class[off / HEAP_SLAB_SIZE] - 1;
+}
+
+/*
+ * Pop a block of a size class, refilling the class with a new slab when
+ * empty. Slabs are never returned to the first-fit free space. Called
+ * with lock held.
+ */
+static struct heap_block *heap_class_pop(unsigned long c)
+{
+	unsigned long slab, i, bsize = heap_class_size(c);
+	struct heap_block *b;
+
+	if (!hpctrl.class_free[c]) {
+		slab = (unsigned long)heap_alloc_large(HEAP_SLAB_SIZE,
+						       HEAP_SLAB_SIZE);
+		if (!slab)
+			return NULL;
+
+		hpctrl.slab_class[(slab - hpctrl.base) / HEAP_SLAB_SIZE] = c + 1;
+		for (i = HEAP_SLAB_SIZE; i; i -= bsize) {
+			b = (struct heap_block *)(slab + i - bsize);
+			b->next = hpctrl.class_free[c];
+			hpctrl.class_free[c] = b;
+		}
+		hpctrl.class_free_size += HEAP_SLAB_SIZE;
+	}
+
+	b = hpctrl.class_free[c];
+	hpctrl.class_free[c] = b->next;
+	hpctrl.class_free_size -= bsize;
+
+	return b;
+}
+
+/* Push a block back to its size class, called with lock held */
+static void heap_class_push(unsigned long c, struct heap_block *b)
+{
+	b->next = hpctrl.class_free[c];
+	hpctrl.class_free[c] = b;
+	hpctrl.class_free_size += heap_class_size(c);
+}
+
+static inline void *heap_class_alloc(unsigned long size)
+{
+	return heap_class_pop(heap_class_index(size));
+}
+
+/* Size of a block of a size class or zero if not in a slab */
+static inline unsigned long heap_class_block_size(void *ptr)
+{
+	long c = heap_slab_class(ptr);
+
+	return (c < 0) ? 0 : heap_class_size(c);
+}
+
+static bool heap_class_free(void *ptr)
+{
+	long c = heap_slab_class(ptr);
+
+	if (c < 0)
+		return false;
+
+	heap_class_push(c, (struct heap_block *)((unsigned long)ptr &
+						  ~(heap_class_size(c) - 1)));
+
+	return true;
+}
+
+static inline unsigned long heap_class_free_space(void)
+{
+	return hpctrl.class_free_size;
+}
+
+/* Reserve the slab class map at the start of the housekeeping area */
+static unsigned long heap_class_init(void)
+{
+	unsigned long count = hpctrl.size / HEAP_SLAB_SIZE;
+
+	hpctrl.slab_class = (u8 *)hpctrl.hkbase;
+	sbi_memset(hpctrl.slab_class, 0, count);
+	sbi_memset(hpctrl.class_free, 0, sizeof(hpctrl.class_free));
+	hpctrl.class_free_size = 0;
+
+	return ROUNDUP(count, sizeof(unsigned long));
+}
+
+#else
+
+static inline void *heap_class_alloc(unsigned long size)
+{
+	return NULL;
+}
+
+static inline unsigned long heap_class_block_size(void *ptr)
+{
+	return 0;
+}
+
+static inline bool heap_class_free(void *ptr)
+{
+	return false;
+}
+
+static inline unsigned long heap_class_free_space(void)
+{
+	return 0;
+}
+
+static inline unsigned long heap_class_init(void)
+{
+	return 0;
+}
+
+#endif
+
+#ifdef CONFIG_SBI_HEAP_HART_CACHE
+
+/* Blocks moved between a HART cache and the size classes at once */
+#define HEAP_CACHE_BATCH		4
+/* Blocks of a size class a HART cache holds before draining a batch */
+#define HEAP_CACHE_MAX			(2 * HEAP_CACHE_BATCH)
+
+/*
+ * Per-HART magazine of free blocks for each size class, in the scratch
+ * space. Only the owning HART touches it except for the statistics.
+ */
+struct heap_hart_cache {
+	struct heap_block *free[HEAP_CLASS_COUNT];
+	unsigned int count[HEAP_CLASS_COUNT];
+	/** Allocations and frees served by the cache */
+	unsigned long allocs;
+	unsigned long frees;
+	/** Heap lock acquisitions to refill or drain the cache */
+	unsigned long locks;
+};
+
+static unsigned long heap_cache_off;
+
+static inline struct heap_hart_cache *heap_cache_thishart(void)
+{
+	if (!heap_cache_off)
+		return NULL;
+
+	return sbi_scratch_thishart_offset_ptr(heap_cache_off);
+}
+
+static void *heap_cache_alloc(unsigned long size)
+{
+	struct heap_hart_cache *hc = heap_cache_thishart();
+	struct heap_block *b;
+	unsigned long c, i;
+
+	if (!hc)
+		return NULL;
+
+	c = heap_class_index(size);
+	if (!hc->free[c]) {
+		spin_lock(&hpctrl.lock);
+		for (i = 0; i < HEAP_CACHE_BATCH; i++) {
+			b = heap_class_pop(c);
+			if (!b)
+				break;
+			b->next = hc->free[c];
+			hc->free[c] = b;
+		}
+		spin_unlock(&hpctrl.lock);
+
+		hc->count[c] = i;
+		hc->locks++;
+		if (!i)
+			return NULL;
+	}
+
+	b = hc->free[c];
+	hc->free[c] = b->next;
+	hc->count[c]--;
+	hc->allocs++;
+
+	return b;
+}
+
+static bool heap_cache_free(void *ptr)
+{
+	struct heap_hart_cache *hc = heap_cache_thishart();
+	long c = heap_slab_class(ptr);
+	struct heap_block *b;
+	unsigned long i;
+
+	if (!hc || c < 0)
+		return false;
+
+	b = (struct heap_block *)((unsigned long)ptr &
+				  ~(heap_class_size(c) - 1));
+	b->next = hc->free[c];
+	hc->free[c] = b;
+	hc->count[c]++;
+	hc->frees++;
+
+	if (HEAP_CACHE_MAX < hc->count[c]) {
+		spin_lock(&hpctrl.lock);
+		for (i = 0; i < HEAP_CACHE_BATCH; i++) {
+			b = hc->free[c];
+			hc->free[c] = b->next;
+			heap_class_push(c, b);
 		}
+		spin_unlock(&hpctrl.lock);
+
+		hc->count[c] -= HEAP_CACHE_BATCH;
+		hc->locks++;
+	}
+
+	return true;
+}
+
+static unsigned long heap_cache_free_space(void)
+{
+	struct heap_hart_cache *hc;
+	struct sbi_scratch *scratch;
+	unsigned long ret = 0;
+	u32 i, c;
+
+	if (!heap_cache_off)
+		return 0;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		scratch = sbi_hartindex_to_scratch(i);
+		if (!scratch)
+			continue;
+		hc = sbi_scratch_offset_ptr(scratch, heap_cache_off);
+		for (c = 0; c < HEAP_CLASS_COUNT; c++)
+			ret += hc->count[c] * heap_class_size(c);
 	}
 
+	return ret;
+}
+
+static void heap_cache_dump(void)
+{
+	struct heap_hart_cache *hc;
+	struct sbi_scratch *scratch;
+	unsigned long ops;
+	u32 i;
+
+	if (!heap_cache_off)
+		return;
+
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		scratch = sbi_hartindex_to_scratch(i);
+		if (!scratch)
+			continue;
+		hc = sbi_scratch_offset_ptr(scratch, heap_cache_off);
+		ops = hc->allocs + hc->frees;
+		if (!ops)
+			continue;
+		sbi_printf("hart%u heap cache: %lu allocs %lu frees %lu locks "
+			   "(%lu lock acquisitions saved)\n",
+			   sbi_hartindex_to_hartid(i), hc->allocs, hc->frees,
+			   hc->locks, (hc->locks < ops) ? ops - hc->locks : 0);
+	}
+}
+
+static void heap_cache_init(void)
+{
+	heap_cache_off = sbi_scratch_alloc_type_offset(struct heap_hart_cache);
+}
+
+#else
+
+static inline void *heap_cache_alloc(unsigned long size)
+{
+	return NULL;
+}
+
+static inline bool heap_cache_free(void *ptr)
+{
+	return false;
+}
+
+static inline unsigned long heap_cache_free_space(void)
+{
+	return 0;
+}
+
+static inline void heap_cache_dump(void) { }
+
+static inline void heap_cache_init(void) { }
+
+#endif
+
+#ifdef CONFIG_SBI_HEAP_STATS
+
+/* Number of call sites accounted individually */
+#define HEAP_STATS_SITES		32
+/* Slots of the call sites which did not get a slot and of unnamed ones */
+#define HEAP_STATS_SITE_OTHER		HEAP_STATS_SITES
+#define HEAP_STATS_SITE_UNKNOWN		(HEAP_STATS_SITES + 1)
+
+struct heap_stats_site {
+	const char *name;
+	unsigned long allocs;
+	unsigned long bytes;
+};
+
+/*
+ * Heap statistics are updated under their own lock so that allocations
+ * served by the HART caches do not take the heap lock.
+ */
+struct heap_stats {
+	spinlock_t lock;
+	unsigned long used;
+	unsigned long peak_used;
+	unsigned long used_blocks;
+	unsigned long allocs;
+	unsigned long frees;
+	unsigned long failures;
+	struct heap_stats_site site[HEAP_STATS_SITES + 2];
+};
+
+static struct heap_stats hpstats;
+
+/* Size of an allocated block or zero if not an allocated block */
+static unsigned long heap_block_size(void *ptr)
+{
+	unsigned long addr = (unsigned long)ptr, ret;
+	u16 tag;
+
+	if (addr < heap_start() || heap_end() <= addr)
+		return 0;
+
+	ret = heap_class_block_size(ptr);
+	if (ret)
+		return ret;
+
+	tag = *heap_tag(addr & ~((unsigned long)HEAP_ALLOC_ALIGN - 1));
+	if (!(tag & HEAP_TAG_START) || (tag & HEAP_TAG_FREE))
+		return 0;
+
+	return heap_tag_size(tag);
+}
+
+static struct heap_stats_site *heap_stats_site(const char *name)
+{
+	unsigned long i, s = ((unsigned long)name >> 3) % HEAP_STATS_SITES;
+
+	if (!name)
+		return &hpstats.site[HEAP_STATS_SITE_UNKNOWN];
+
+	for (i = 0; i < HEAP_STATS_SITES; i++) {
+		if (!hpstats.site[s].name)
+			hpstats.site[s].name = name;
+		if (hpstats.site[s].name == name)
+			return &hpstats.site[s];
+		s = (s + 1) % HEAP_STATS_SITES;
+	}
+
+	return &hpstats.site[HEAP_STATS_SITE_OTHER];
+}
+
+static void heap_stats_alloc(const char *site, void *ptr, size_t size)
+{
+	struct heap_stats_site *hs;
+
+	spin_lock(&hpstats.lock);
+
+	if (ptr) {
+		hpstats.used += heap_block_size(ptr);
+		if (hpstats.peak_used < hpstats.used)
+			hpstats.peak_used = hpstats.used;
+		hpstats.used_blocks++;
+		hpstats.allocs++;
+
+		hs = heap_stats_site(site);
+		hs->allocs++;
+		hs->bytes += size;
+	} else {
+		hpstats.failures++;
+	}
+
+	spin_unlock(&hpstats.lock);
+}
+
+/*
+ * Blocks of a size class carry no used flag, so a double free of such a
+ * block is not detected here and is accounted twice.
+ */
+static void heap_stats_free(void *ptr)
+{
+	unsigned long size = heap_block_size(ptr);
+
+	if (!size)
+		return;
+
+	spin_lock(&hpstats.lock);
+	hpstats.used -= size;
+	hpstats.used_blocks--;
+	hpstats.frees++;
+	spin_unlock(&hpstats.lock);
+}
+
+int sbi_heap_stats_read(struct sbi_heap_stats *stats)
+{
+	struct heap_free_block *fb;
+	unsigned long bsize;
+
+	stats->size = hpctrl.size - hpctrl.hksize;
+	stats->free = sbi_heap_free_space();
+	stats->largest_free = 0;
+	stats->free_blocks = 0;
+
+	spin_lock(&hpctrl.lock);
+	sbi_list_for_each_entry(fb, &hpctrl.free_space_list, head) {
+		bsize = heap_tag_size(*heap_tag((unsigned long)fb));
+		if (stats->largest_free < bsize)
+			stats->largest_free = bsize;
+		stats->free_blocks++;
+	}
 	spin_unlock(&hpctrl.lock);
 
+	spin_lock(&hpstats.lock);
+	stats->used = hpstats.used;
+	stats->peak_used = hpstats.peak_used;
+	stats->used_blocks = hpstats.used_blocks;
+	stats->allocs = hpstats.allocs;
+	stats->frees = hpstats.frees;
+	stats->failures = hpstats.failures;
+	spin_unlock(&hpstats.lock);
+
+	return 0;
+}
+
+void sbi_heap_stats_print(void)
+{
+	struct heap_stats_site *hs;
+	struct sbi_heap_stats st;
+	unsigned long i;
+
+	sbi_heap_stats_read(&st);
+
+	sbi_printf("Heap stats: %lu bytes used (peak %lu) in %lu blocks, "
+		   "%lu bytes free\n", st.used, st.peak_used, st.used_blocks,
+		   st.free);
+	sbi_printf("Heap stats: %lu free blocks, largest %lu bytes, "
+		   "%lu allocs %lu frees %lu failed\n", st.free_blocks,
+		   st.largest_free, st.allocs, st.frees, st.failures);
+
+	sbi_printf("Heap allocations by caller:\n");
+	for (i = 0; i < array_size(hpstats.site); i++) {
+		hs = &hpstats.site[i];
+		if (!hs->allocs)
+			continue;
+		sbi_printf("  %-32s %6lu allocs %8lu bytes\n",
+			   (i == HEAP_STATS_SITE_OTHER) ? "other" :
+			   (i == HEAP_STATS_SITE_UNKNOWN) ? "unknown" :
+			   hs->name, hs->allocs, hs->bytes);
+	}
+}
+
+static void heap_stats_init(void)
+{
+	sbi_memset(&hpstats, 0, sizeof(hpstats));
+	SPIN_LOCK_INIT(hpstats.lock);
+}
+
+#else
+
+static inline void heap_stats_alloc(const char *site, void *ptr,
+				    size_t size) { }
+
+static inline void heap_stats_free(void *ptr) { }
+
+static inline void heap_stats_init(void) { }
+
+#endif
+
+static void *heap_malloc(size_t size, const char *site)
+{
+	unsigned long asize;
+	void *ret = NULL;
+
+	if (!size)
+		return NULL;
+
+	asize = size + HEAP_ALLOC_ALIGN - 1;
+	asize &= ~((unsigned long)HEAP_ALLOC_ALIGN - 1);
+
+	if (asize <= HEAP_CLASS_MAX_SIZE)
+		ret = heap_cache_alloc(asize);
+
+	if (!ret) {
+		spin_lock(&hpctrl.lock);
+
+		if (asize <= HEAP_CLASS_MAX_SIZE)
+			ret = heap_class_alloc(asize);
+		if (!ret)
+			ret = heap_alloc_large(asize, HEAP_ALLOC_ALIGN);
+
+		spin_unlock(&hpctrl.lock);
+	}
+
+	heap_stats_alloc(site, ret, size);
+
 	return ret;
 }
 
-void *sbi_zalloc(size_t size)
+static void *heap_zalloc(size_t size, const char *site)
 {
-	void *ret = sbi_malloc(size);
+	void *ret = heap_malloc(size, site);
 
 	if (ret)
 		sbi_memset(ret, 0, size);
 	return ret;
 }
 
-void sbi_free(void *ptr)
+void *sbi_malloc(size_t size)
 {
-	struct heap_node *n, *np;
+	return heap_malloc(size, NULL);
+}
+
+void *sbi_zalloc(size_t size)
+{
+	return heap_zalloc(size, NULL);
+}
 
+#ifdef CONFIG_SBI_HEAP_STATS
+
+void *sbi_malloc_site(size_t size, const char *site)
+{
+	return heap_malloc(size, site);
+}
+
+void *sbi_zalloc_site(size_t size, const char *site)
+{
+	return heap_zalloc(size, site);
+}
+
+#endif
+
+void sbi_free(void *ptr)
+{
 	if (!ptr)
 		return;
 
-	spin_lock(&hpctrl.lock);
+	heap_stats_free(ptr);
 
-	np = NULL;
-	sbi_list_for_each_entry(n, &hpctrl.used_space_list, head) {
-		if ((n->addr <= (unsigned long)ptr) &&
-		    ((unsigned long)ptr < (n->addr + n->size))) {
-			np = n;
-			break;
-		}
-	}
-	if (!np) {
-		spin_unlock(&hpctrl.lock);
+	if (heap_cache_free(ptr))
 		return;
-	}
 
-	sbi_list_del(&np->head);
+	spin_lock(&hpctrl.lock);
 
-	sbi_list_for_each_entry(n, &hpctrl.free_space_list, head) {
-		if ((np->addr + np->size) == n->addr) {
-			n->addr = np->addr;
-			n->size += np->size;
-			sbi_list_add_tail(&np->head, &hpctrl.free_node_list);
-			np = NULL;
-			break;
-		} else if (np->addr == (n->addr + n->size)) {
-			n->size += np->size;
-			sbi_list_add_tail(&np->head, &hpctrl.free_node_list);
-			np = NULL;
-			break;
-		} else if ((n->addr + n->size) < np->addr) {
-			sbi_list_add(&np->head, &n->head);
-			np = NULL;
-			break;
-		}
-	}
-	if (np)
-		sbi_list_add_tail(&np->head, &hpctrl.free_space_list);
+	if (!heap_class_free(ptr))
+		heap_free_large(ptr);
 
 	spin_unlock(&hpctrl.lock);
 }
 
 unsigned long sbi_heap_free_space(void)
 {
-	struct heap_node *n;
-	unsigned long ret = 0;
+	unsigned long ret;
 
 	spin_lock(&hpctrl.lock);
-	sbi_list_for_each_entry(n, &hpctrl.free_space_list, head)
-		ret += n->size;
+	ret = hpctrl.free_size + heap_class_free_space();
 	spin_unlock(&hpctrl.lock);
 
-	return ret;
+	return ret + heap_cache_free_space();
 }
 
 unsigned long sbi_heap_used_space(void)
@@ -160,10 +815,22 @@ unsigned long sbi_heap_reserved_space(void)
 	return hpctrl.hksize;
 }
 
+#if defined(CONFIG_SBI_HEAP_HART_CACHE) || defined(CONFIG_SBI_HEAP_STATS)
+
+void sbi_heap_stats_dump(void)
+{
+	sbi_printf("Heap: %lu bytes used, %lu bytes free, %lu bytes reserved\n",
+		   sbi_heap_used_space(), sbi_heap_free_space(),
+		   sbi_heap_reserved_space());
+	heap_cache_dump();
+	sbi_heap_stats_print();
+}
+
+#endif
+
 int sbi_heap_init(struct sbi_scratch *scratch)
 {
-	unsigned long i;
-	struct heap_node *n;
+	unsigned long size, tags_off, tags_size;
 
 	/* Sanity checks on heap offset and size */
 	if (!scratch->fw_heap_size ||
@@ -178,27 +845,30 @@ int sbi_heap_init(struct sbi_scratch *scratch)
 	hpctrl.base = scratch->fw_start + scratch->fw_heap_offset;
 	hpctrl.size = scratch->fw_heap_size;
 	hpctrl.hkbase = hpctrl.base;
-	hpctrl.hksize = hpctrl.size / HEAP_HOUSEKEEPING_FACTOR;
-	hpctrl.hksize &= ~((unsigned long)HEAP_BASE_ALIGN - 1);
-	SBI_INIT_LIST_HEAD(&hpctrl.free_node_list);
 	SBI_INIT_LIST_HEAD(&hpctrl.free_space_list);
-	SBI_INIT_LIST_HEAD(&hpctrl.used_space_list);
-
-	/* Prepare free node list */
-	for (i = 0; i < (hpctrl.hksize / sizeof(*n)); i++) {
-		n = (struct heap_node *)(hpctrl.hkbase + (sizeof(*n) * i));
-		SBI_INIT_LIST_HEAD(&n->head);
-		n->addr = n->size = 0;
-		sbi_list_add_tail(&n->head, &hpctrl.free_node_list);
+
+	/* Carve slab map and boundary tags from housekeeping area */
+	tags_off = heap_class_init();
+	tags_size = (hpctrl.size / HEAP_ALLOC_ALIGN) * sizeof(*hpctrl.tags);
+	hpctrl.tags = (u16 *)(hpctrl.hkbase + tags_off);
+	hpctrl.hksize = ROUNDUP(tags_off + tags_size, HEAP_BASE_ALIGN);
+	if (hpctrl.size <= hpctrl.hksize)
+		return SBI_EINVAL;
+	sbi_memset(hpctrl.tags, 0, tags_size);
+
+	/* Prepare free space list, blocks are limited by the tag size */
+	hpctrl.free_size = 0;
+	while (hpctrl.free_size < (hpctrl.size - hpctrl.hksize)) {
+		size = hpctrl.size - hpctrl.hksize - hpctrl.free_size;
+		if (HEAP_BLOCK_MAX_SIZE < size)
+			size = HEAP_BLOCK_MAX_SIZE & ~(HEAP_BASE_ALIGN - 1);
+		heap_set_block(heap_start() + hpctrl.free_size, size, true);
+		heap_add_free_block(heap_start() + hpctrl.free_size);
+		hpctrl.free_size += size;
 	}
 
-	/* Prepare free space list */
-	n = sbi_list_first_entry(&hpctrl.free_node_list,
-				 struct heap_node, head);
-	sbi_list_del(&n->head);
-	n->addr = hpctrl.hkbase + hpctrl.hksize;
-	n->size = hpctrl.size - hpctrl.hksize;
-	sbi_list_add_tail(&n->head, &hpctrl.free_space_list);
+	heap_cache_init();
+	heap_stats_init();
 
 	return 0;
 }
@@ -24,6 +24,7 @@
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_timer.h>
+#include <sbi/sbi_unit_test.h>
 #include <sbi/sbi_console.h>
 
 #define __sbi_hsm_hart_change_state(hdata, oldstate, newstate)		\
@@ -32,15 +33,25 @@
 	if (state != (oldstate))					\
 		sbi_printf("%s: ERR: The hart is in invalid state [%lu]\n", \
 			   __func__, state);				\
+	else								\
+		hsm_interruptible_update(hdata, newstate);		\
 	state == (oldstate);						\
 })
 
 static const struct sbi_hsm_device *hsm_dev = NULL;
 static unsigned long hart_data_offset;
 
+/*
+ * HART indices of all HARTs in an interruptible state, updated on each
+ * HSM state transition so that IPI target masks can be built without
+ * looking at the state of every HART.
+ */
+static struct sbi_hartmask hsm_interruptible_harts;
+
 /** Per hart specific data to manage state transition **/
 struct sbi_hsm_data {
 	atomic_t state;
+	u32 hartindex;
 	unsigned long suspend_type;
 	unsigned long saved_mie;
 	unsigned long saved_mip;
@@ -52,6 +63,24 @@ struct sbi_hsm_data {
 	atomic_t start_ticket;
 };
 
+static inline bool hsm_state_interruptible(long state)
+{
+	return (state == SBI_HSM_STATE_STARTED ||
+		state == SBI_HSM_STATE_SUSPENDED ||
+		state == SBI_HSM_STATE_RESUME_PENDING) ? true : false;
+}
+
+static void hsm_interruptible_update(struct sbi_hsm_data *hdata,
+				     long newstate)
+{
+	if (hsm_state_interruptible(newstate))
+		atomic_raw_set_bit(hdata->hartindex,
+				   hsm_interruptible_harts.bits);
+	else
+		atomic_raw_clear_bit(hdata->hartindex,
+				     hsm_interruptible_harts.bits);
+}
+
 bool sbi_hsm_hart_change_state(struct sbi_scratch *scratch, long oldstate,
 			       long newstate)
 {
@@ -107,6 +136,30 @@ static void hsm_start_ticket_release(struct sbi_hsm_data *hdata)
 	atomic_write(&hdata->start_ticket, 0);
 }
 
+/**
+ * Get hartmask of all interruptible HARTs assigned to a domain
+ * @param dom the domain to be used for output hartmask
+ * @param out_mask the output hartmask
+ * @return 0 on success and SBI_Exxx (< 0) on failure
+ */
+int sbi_hsm_hart_interruptible_hartmask(const struct sbi_domain *dom,
+					struct sbi_hartmask *out_mask)
+{
+	struct sbi_domain *tdom = (struct sbi_domain *)dom;
+
+	if (!dom) {
+		sbi_hartmask_clear_all(out_mask);
+		return SBI_EINVAL;
+	}
+
+	spin_lock(&tdom->assigned_harts_lock);
+	sbi_hartmask_and(out_mask, &tdom->assigned_harts,
+			 &hsm_interruptible_harts);
+	spin_unlock(&tdom->assigned_harts_lock);
+
+	return 0;
+}
+
 /**
  * Get ulong HART mask for given HART base ID
  * @param dom the domain to be used for output HART mask
@@ -118,24 +171,21 @@ static void hsm_start_ticket_release(struct sbi_hsm_data *hdata)
 int sbi_hsm_hart_interruptible_mask(const struct sbi_domain *dom,
 				    ulong hbase, ulong *out_hmask)
 {
-	int hstate;
-	ulong i, hmask, dmask;
+	struct sbi_hartmask mask;
+	ulong i;
+	int rc;
 
 	*out_hmask = 0;
 	if (!sbi_hartid_valid(hbase))
 		return SBI_EINVAL;
 
-	dmask = sbi_domain_get_assigned_hartmask(dom, hbase);
+	rc = sbi_hsm_hart_interruptible_hartmask(dom, &mask);
+	if (rc)
+		return rc;
+
 	for (i = 0; i < BITS_PER_LONG; i++) {
-		hmask = 1UL << i;
-		if (!(dmask & hmask))
-			continue;
-
-		hstate = __sbi_hsm_hart_get_state(hbase + i);
-		if (hstate == SBI_HSM_STATE_STARTED ||
-		    hstate == SBI_HSM_STATE_SUSPENDED ||
-		    hstate == SBI_HSM_STATE_RESUME_PENDING)
-			*out_hmask |= hmask;
+		if (sbi_hartmask_test_hartid(hbase + i, &mask))
+			*out_hmask |= 1UL << i;
 	}
 
 	return 0;
@@ -176,6 +226,7 @@ static void sbi_hsm_hart_wait(struct sbi_scratch *scratch, u32 hartid)
 	/* Wait for state transition requested by sbi_hsm_hart_start() */
 	while (atomic_read(&hdata->state) != SBI_HSM_STATE_START_PENDING) {
 		wfi();
+		sbiunit_hsm_wait_poll();
 	}
 
 	/* Restore MIE CSR */
@@ -248,7 +299,10 @@ int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 	struct sbi_hsm_data *hdata;
 
 	if (cold_boot) {
-		hart_data_offset = sbi_scratch_alloc_offset(sizeof(*hdata));
+		/* HART state is changed by other HARTs on start and stop */
+		hart_data_offset = sbi_scratch_alloc_offset_aligned(
+					sizeof(*hdata), sizeof(unsigned long),
+					SBI_SCRATCH_ALLOC_REMOTE);
 		if (!hart_data_offset)
 			return SBI_ENOMEM;
 
@@ -265,6 +319,7 @@ int sbi_hsm_init(struct sbi_scratch *scratch, u32 hartid, bool cold_boot)
 				    SBI_HSM_STATE_START_PENDING :
 				    SBI_HSM_STATE_STOPPED);
 			ATOMIC_INIT(&hdata->start_ticket, 0);
+			hdata->hartindex = i;
 		}
 	} else {
 		sbi_hsm_hart_wait(scratch, hartid);
@@ -14,8 +14,11 @@
 #include <sbi/sbi_emulate_csr.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_illegal_insn.h>
+#include <sbi/sbi_insn_cache.h>
 #include <sbi/sbi_pmu.h>
+#include <sbi/sbi_timer.h>
 #include <sbi/sbi_trap.h>
+#include <sbi/sbi_trap_stats.h>
 #include <sbi/sbi_unpriv.h>
 #include <sbi/sbi_console.h>
 
@@ -31,6 +34,7 @@ static int truly_illegal_insn(ulong insn, struct sbi_trap_regs *regs)
 	trap.tinst = 0;
 	trap.gva   = 0;
 
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_ILLEGAL_INSN_REDIRECT);
 	return sbi_trap_redirect(regs, &trap);
 }
 
@@ -39,6 +43,7 @@ static int misc_mem_opcode_insn(ulong insn, struct sbi_trap_regs *regs)
 	/* Errata workaround: emulate `fence.tso` as `fence rw, rw`. */
 	if ((insn & INSN_MASK_FENCE_TSO) == INSN_MATCH_FENCE_TSO) {
 		smp_mb();
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_ILLEGAL_INSN_FENCE_TSO);
 		regs->mepc += 4;
 		return 0;
 	}
@@ -96,6 +101,8 @@ static int system_opcode_insn(ulong insn, struct sbi_trap_regs *regs)
 
 	SET_RD(insn, regs, csr_val);
 
+	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_ILLEGAL_INSN_CSR);
+	sbi_trap_stats_csr(csr_num);
 	regs->mepc += 4;
 
 	return 0;
@@ -141,6 +148,7 @@ int sbi_illegal_insn_handler(struct sbi_trap_context *tcntx)
 	struct sbi_trap_regs *regs = &tcntx->regs;
 	ulong insn = tcntx->trap.tval;
 	struct sbi_trap_info uptrap;
+	struct sbi_insn_info info = { 0 };
 
 	/*
 	 * We only deal with 32-bit (or longer) illegal instructions. If we
@@ -154,13 +162,30 @@ int sbi_illegal_insn_handler(struct sbi_trap_context *tcntx)
 	 */
 
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_ILLEGAL_INSN);
+	if (sbi_timer_emulate_rdtime(regs, insn)) {
+		sbi_trap_stats_illegal_insn(insn);
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_ILLEGAL_INSN_CSR);
+		sbi_trap_stats_csr((u32)insn >> 20);
+		return 0;
+	}
+
 	if (unlikely((insn & 3) != 3)) {
-		insn = sbi_get_insn(regs->mepc, &uptrap);
-		if (uptrap.cause)
-			return sbi_trap_redirect(regs, &uptrap);
-		if ((insn & 3) != 3)
-			return truly_illegal_insn(insn, regs);
+		if (sbi_insn_cache_lookup(regs, SBI_INSN_RAW, &info)) {
+			insn = info.insn;
+		} else {
+			insn = sbi_get_insn(regs->mepc, &uptrap);
+			if (uptrap.cause)
+				return sbi_trap_redirect(regs, &uptrap);
+			info.insn = insn;
+			info.insn_len = INSN_LEN(insn);
+			info.type = SBI_INSN_RAW;
+			sbi_insn_cache_insert(regs, &info);
+		}
 	}
 
+	sbi_trap_stats_illegal_insn(insn);
+	if (unlikely((insn & 3) != 3))
+		return truly_illegal_insn(insn, regs);
+
 	return illegal_insn_table[(insn & 0x7c) >> 2](insn, regs);
 }
@@ -19,6 +19,7 @@
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_heap.h>
 #include <sbi/sbi_hsm.h>
+#include <sbi/sbi_insn_cache.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_irqchip.h>
 #include <sbi/sbi_platform.h>
@@ -29,6 +30,7 @@
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_timer.h>
 #include <sbi/sbi_tlb.h>
+#include <sbi/sbi_trap_stats.h>
 #include <sbi/sbi_version.h>
 #include <sbi/sbi_unit_test.h>
 
@@ -116,6 +118,14 @@ static void sbi_boot_print_general(struct sbi_scratch *scratch)
 	cppc_dev = sbi_cppc_get_device();
 	sbi_printf("Platform CPPC Device      : %s\n",
 		   (cppc_dev) ? cppc_dev->name : "---");
+	sbi_printf("Platform TLB Flush Limit  : "
+		   "%lu B (sfence.vma), %lu B (hfence.gvma), "
+		   "%lu B (hfence.vvma)%s\n",
+		   sbi_tlb_range_flush_limit(SBI_TLB_SFENCE_VMA),
+		   sbi_tlb_range_flush_limit(SBI_TLB_HFENCE_GVMA),
+		   sbi_tlb_range_flush_limit(SBI_TLB_HFENCE_VVMA),
+		   sbi_tlb_range_flush_limit_calibrated() ?
+		   " (calibrated)" : "");
 
 	/* Firmware details */
 	sbi_printf("Firmware Base             : 0x%lx\n", scratch->fw_start);
@@ -303,6 +313,20 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 		sbi_hart_hang();
 	}
 
+	rc = sbi_insn_cache_init(scratch, true);
+	if (rc) {
+		sbi_printf("%s: insn cache init failed (error %d)\n",
+			   __func__, rc);
+		sbi_hart_hang();
+	}
+
+	rc = sbi_trap_stats_init(scratch, true);
+	if (rc) {
+		sbi_printf("%s: trap stats init failed (error %d)\n",
+			   __func__, rc);
+		sbi_hart_hang();
+	}
+
 	rc = sbi_timer_init(scratch, true);
 	if (rc) {
 		sbi_printf("%s: timer init failed (error %d)\n", __func__, rc);
@@ -357,6 +381,9 @@ static void __noreturn init_coldboot(struct sbi_scratch *scratch, u32 hartid)
 
 	sbi_boot_print_hart(scratch, hartid);
 
+	if (!(scratch->options & SBI_SCRATCH_NO_BOOT_PRINTS))
+		sbi_heap_stats_print();
+
 	run_all_tests();
 
 	/*
@@ -426,6 +453,14 @@ static void __noreturn init_warm_startup(struct sbi_scratch *scratch,
 	if (rc)
 		sbi_hart_hang();
 
+	rc = sbi_insn_cache_init(scratch, false);
+	if (rc)
+		sbi_hart_hang();
+
+	rc = sbi_trap_stats_init(scratch, false);
+	if (rc)
+		sbi_hart_hang();
+
 	rc = sbi_timer_init(scratch, false);
 	if (rc)
 		sbi_hart_hang();
@@ -0,0 +1,160 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Per-HART cache of instructions fetched for trap emulation
+ *
+ * Fetching the trapped instruction with an unprivileged access is the
+ * dominant cost of emulating a trap without MTINST. Entries are keyed by
+ * the PC, the privilege mode and the address translation of the trap and
+ * are invalidated when remote FENCE.I or SFENCE/HFENCE requests are
+ * processed on the HART.
+ *
+ * A supervisor can remap a page and flush it with a local SFENCE.VMA,
+ * which M-mode does not see, so a cached entry may then describe the
+ * instruction previously mapped at the same PC. User pages are remapped
+ * this way far more often than supervisor text, hence traps from U-mode
+ * and VU-mode are never cached.
+ */
+
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_insn_cache.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_trap.h>
+
+struct insn_cache_entry {
+	ulong mepc;
+	/** Previous privilege and virtualization mode, -1 if invalid */
+	ulong priv;
+	ulong satp;
+	ulong hgatp;
+	struct sbi_insn_info info;
+};
+
+struct insn_cache {
+	struct insn_cache_entry entries[SBI_INSN_CACHE_ENTRIES];
+};
+
+static unsigned long insn_cache_off;
+
+static inline struct insn_cache *insn_cache_thishart(void)
+{
+	if (!insn_cache_off)
+		return NULL;
+
+	return sbi_scratch_read_type(sbi_scratch_thishart_ptr(), void *,
+				     insn_cache_off);
+}
+
+/**
+ * Compute the cache key of a trap
+ *
+ * @return false if the trap must not be cached
+ */
+static bool insn_cache_key(const struct sbi_trap_regs *regs,
+			   struct insn_cache_entry *key)
+{
+	ulong mpp = (regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT;
+#if __riscv_xlen == 32
+	bool virt = (regs->mstatusH & MSTATUSH_MPV) ? true : false;
+#else
+	bool virt = (regs->mstatus & MSTATUS_MPV) ? true : false;
+#endif
+
+	if (mpp == PRV_U)
+		return false;
+
+	key->mepc = regs->mepc;
+	key->priv = mpp | (virt ? 0x4 : 0);
+	if (virt) {
+		key->satp = csr_read(CSR_VSATP);
+		key->hgatp = csr_read(CSR_HGATP);
+	} else {
+		key->satp = csr_read(CSR_SATP);
+		key->hgatp = 0;
+	}
+
+	return true;
+}
+
+static inline struct insn_cache_entry *insn_cache_slot(struct insn_cache *ic,
+							ulong mepc)
+{
+	return &ic->entries[(mepc >> 1) & (SBI_INSN_CACHE_ENTRIES - 1)];
+}
+
+bool sbi_insn_cache_lookup(const struct sbi_trap_regs *regs, u8 type,
+			   struct sbi_insn_info *info)
+{
+	struct insn_cache *ic = insn_cache_thishart();
+	struct insn_cache_entry key, *e;
+
+	if (!ic || !insn_cache_key(regs, &key))
+		return false;
+
+	e = insn_cache_slot(ic, key.mepc);
+	if (e->mepc != key.mepc || e->priv != key.priv ||
+	    e->satp != key.satp || e->hgatp != key.hgatp ||
+	    e->info.type != type)
+		return false;
+
+	*info = e->info;
+	return true;
+}
+
+void sbi_insn_cache_insert(const struct sbi_trap_regs *regs,
+			   const struct sbi_insn_info *info)
+{
+	struct insn_cache *ic = insn_cache_thishart();
+	struct insn_cache_entry key, *e;
+
+	if (!ic || !insn_cache_key(regs, &key))
+		return;
+
+	e = insn_cache_slot(ic, key.mepc);
+	*e = key;
+	e->info = *info;
+}
+
+static void insn_cache_flush(struct insn_cache *ic)
+{
+	int i;
+
+	for (i = 0; i < SBI_INSN_CACHE_ENTRIES; i++)
+		ic->entries[i].priv = -1UL;
+}
+
+void sbi_insn_cache_flush(void)
+{
+	struct insn_cache *ic = insn_cache_thishart();
+
+	if (ic)
+		insn_cache_flush(ic);
+}
+
+int sbi_insn_cache_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	struct insn_cache *ic;
+
+	if (cold_boot) {
+		insn_cache_off = sbi_scratch_alloc_type_offset(void *);
+		if (!insn_cache_off)
+			return SBI_ENOMEM;
+	} else if (!insn_cache_off) {
+		return SBI_ENOMEM;
+	}
+
+	ic = sbi_scratch_read_type(scratch, void *, insn_cache_off);
+	if (!ic) {
+		ic = sbi_malloc(sizeof(*ic));
+		if (!ic)
+			return SBI_ENOMEM;
+		sbi_scratch_write_type(scratch, void *, insn_cache_off, ic);
+	}
+
+	insn_cache_flush(ic);
+
+	return 0;
+}
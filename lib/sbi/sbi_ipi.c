@@ -25,6 +25,10 @@
 
 struct sbi_ipi_data {
 	unsigned long ipi_type;
+#ifdef CONFIG_SBI_IPI_TREE_FANOUT
+	/** HARTs of our group to be triggered on behalf of senders */
+	struct sbi_hartmask fwd_mask;
+#endif
 };
 
 _Static_assert(
@@ -36,8 +40,141 @@ static unsigned long ipi_data_off;
 static const struct sbi_ipi_device *ipi_dev = NULL;
 static const struct sbi_ipi_event_ops *ipi_ops_array[SBI_IPI_EVENT_MAX];
 
+#ifdef CONFIG_SBI_IPI_TREE_FANOUT
+
+/* Minimum number of HARTs triggered through a group leader */
+#define IPI_FANOUT_MIN_MEMBERS		2
+
+/* Group of each HART and the mask of all HARTs in the same group */
+static struct sbi_hartmask ipi_grouped_harts;
+static u32 ipi_hart_group[SBI_HARTMASK_MAX_BITS];
+static struct sbi_hartmask ipi_group_mask[SBI_HARTMASK_MAX_BITS];
+
+static u32 ipi_fwd_event = SBI_IPI_EVENT_MAX;
+
+/*
+ * Trigger the HARTs handed over to this HART as group leader. Besides
+ * the IPI_FWD event, this is called from M-mode wait loops because a
+ * leader waiting with interrupts disabled may itself wait on one of
+ * the HARTs it was asked to trigger.
+ */
+void sbi_ipi_forward(struct sbi_scratch *scratch)
+{
+	struct sbi_ipi_data *ipi_data =
+			sbi_scratch_offset_ptr(scratch, ipi_data_off);
+	struct sbi_hartmask fwd_mask;
+	bool pending = false;
+	u32 i;
+
+	for (i = 0; i < BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS); i++) {
+		fwd_mask.bits[i] = 0;
+		if (!__atomic_load_n(&ipi_data->fwd_mask.bits[i],
+				     __ATOMIC_RELAXED))
+			continue;
+		fwd_mask.bits[i] =
+			atomic_raw_xchg_ulong(&ipi_data->fwd_mask.bits[i], 0);
+		pending = true;
+	}
+
+	if (pending)
+		sbi_ipi_raw_send_mask(&fwd_mask);
+}
+
+static struct sbi_ipi_event_ops ipi_fwd_ops = {
+	.name = "IPI_FWD",
+	.process = sbi_ipi_forward,
+};
+
+/*
+ * Trigger HARTs in given doorbell mask. For each group, the first HART
+ * is triggered directly as group leader and the other HARTs of the
+ * group are handed over to the leader which triggers them from its
+ * IPI_FWD event.
+ */
+static int sbi_ipi_doorbell(struct sbi_hartmask *doorbell)
+{
+	struct sbi_ipi_data *ipi_data;
+	struct sbi_hartmask members, direct = {0};
+	u32 i, j, count;
+	int rc;
+
+	sbi_hartmask_for_each_hartindex(i, doorbell) {
+		sbi_hartmask_and(&members, doorbell, &ipi_group_mask[i]);
+		sbi_hartmask_clear_hartindex(i, &members);
+
+		count = 0;
+		sbi_hartmask_for_each_hartindex(j, &members) {
+			if (++count >= IPI_FANOUT_MIN_MEMBERS)
+				break;
+		}
+		sbi_hartmask_set_hartindex(i, &direct);
+		if (count < IPI_FANOUT_MIN_MEMBERS ||
+		    SBI_IPI_EVENT_MAX <= ipi_fwd_event)
+			continue;
+
+		ipi_data = sbi_scratch_offset_ptr(sbi_hartindex_to_scratch(i),
+						  ipi_data_off);
+		for (j = 0; j < BITS_TO_LONGS(SBI_HARTMASK_MAX_BITS); j++) {
+			if (members.bits[j])
+				__atomic_fetch_or(&ipi_data->fwd_mask.bits[j],
+						  members.bits[j],
+						  __ATOMIC_RELAXED);
+		}
+		__atomic_fetch_or(&ipi_data->ipi_type, BIT(ipi_fwd_event),
+				  __ATOMIC_RELAXED);
+
+		sbi_hartmask_xor(doorbell, doorbell, &members);
+	}
+
+	rc = sbi_ipi_raw_send_mask(&direct);
+	sbi_hartmask_clear_all(doorbell);
+
+	return rc;
+}
+
+int sbi_ipi_set_hart_group(u32 hartindex, u32 group)
+{
+	u32 i;
+
+	if (SBI_HARTMASK_MAX_BITS <= hartindex)
+		return SBI_EINVAL;
+	if (sbi_hartmask_test_hartindex(hartindex, &ipi_grouped_harts))
+		return SBI_EALREADY;
+
+	ipi_hart_group[hartindex] = group;
+	sbi_hartmask_set_hartindex(hartindex, &ipi_grouped_harts);
+	sbi_hartmask_set_hartindex(hartindex, &ipi_group_mask[hartindex]);
+	sbi_hartmask_for_each_hartindex(i, &ipi_grouped_harts) {
+		if (i == hartindex || ipi_hart_group[i] != group)
+			continue;
+		sbi_hartmask_set_hartindex(i, &ipi_group_mask[hartindex]);
+		sbi_hartmask_set_hartindex(hartindex, &ipi_group_mask[i]);
+	}
+
+	return 0;
+}
+
+#else
+
+/* Trigger all HARTs in given doorbell mask directly */
+static int sbi_ipi_doorbell(struct sbi_hartmask *doorbell)
+{
+	int rc = sbi_ipi_raw_send_mask(doorbell);
+
+	sbi_hartmask_clear_all(doorbell);
+
+	return rc;
+}
+
+int sbi_ipi_set_hart_group(u32 hartindex, u32 group)
+{
+	return 0;
+}
+
+#endif
+
 static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartindex,
-			u32 event, void *data)
+			u32 event, void *data, struct sbi_hartmask *doorbell)
 {
 	int ret = 0;
 	struct sbi_scratch *remote_scratch = NULL;
@@ -72,15 +209,16 @@ static int sbi_ipi_send(struct sbi_scratch *scratch, u32 remote_hartindex,
 
 	/*
 	 * Set IPI type on remote hart's scratch area and
-	 * trigger the interrupt.
+	 * add the remote hart to the doorbell mask which
+	 * is triggered by the caller.
 	 *
 	 * Multiple harts may be trying to send IPI to the
-	 * remote hart so call sbi_ipi_raw_send() only when
-	 * the ipi_type was previously zero.
+	 * remote hart so trigger it only when the ipi_type
+	 * was previously zero.
 	 */
 	if (!__atomic_fetch_or(&ipi_data->ipi_type,
 				BIT(event), __ATOMIC_RELAXED))
-		ret = sbi_ipi_raw_send(remote_hartindex);
+		sbi_hartmask_set_hartindex(remote_hartindex, doorbell);
 
 	sbi_pmu_ctr_incr_fw(SBI_PMU_FW_IPI_SENT);
 
@@ -109,40 +247,35 @@ static int sbi_ipi_sync(struct sbi_scratch *scratch, u32 event)
  */
 int sbi_ipi_send_many(ulong hmask, ulong hbase, u32 event, void *data)
 {
-	int rc = 0;
+	int rc = 0, ret;
 	bool retry_needed;
 	ulong i, m;
-	struct sbi_hartmask target_mask = {0};
+	struct sbi_hartmask target_mask, req_mask = {0};
+	struct sbi_hartmask doorbell = {0};
 	struct sbi_domain *dom = sbi_domain_thishart_ptr();
 	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
 
 	/* Find the target harts */
+	rc = sbi_hsm_hart_interruptible_hartmask(dom, &target_mask);
+	if (rc)
+		return rc;
+
 	if (hbase != -1UL) {
-		rc = sbi_hsm_hart_interruptible_mask(dom, hbase, &m);
-		if (rc)
-			return rc;
-		m &= hmask;
+		if (!sbi_hartid_valid(hbase))
+			return SBI_EINVAL;
 
-		for (i = hbase; m; i++, m >>= 1) {
+		for (i = hbase, m = hmask; m; i++, m >>= 1) {
 			if (m & 1UL)
-				sbi_hartmask_set_hartid(i, &target_mask);
-		}
-	} else {
-		hbase = 0;
-		while (!sbi_hsm_hart_interruptible_mask(dom, hbase, &m)) {
-			for (i = hbase; m; i++, m >>= 1) {
-				if (m & 1UL)
-					sbi_hartmask_set_hartid(i, &target_mask);
-			}
-			hbase += BITS_PER_LONG;
+				sbi_hartmask_set_hartid(i, &req_mask);
 		}
+		sbi_hartmask_and(&target_mask, &target_mask, &req_mask);
 	}
 
 	/* Send IPIs */
 	do {
 		retry_needed = false;
 		sbi_hartmask_for_each_hartindex(i, &target_mask) {
-			rc = sbi_ipi_send(scratch, i, event, data);
+			rc = sbi_ipi_send(scratch, i, event, data, &doorbell);
 			if (rc < 0)
 				goto done;
 			if (rc == SBI_IPI_UPDATE_RETRY)
@@ -151,9 +284,22 @@ int sbi_ipi_send_many(ulong hmask, ulong hbase, u32 event, void *data)
 				sbi_hartmask_clear_hartindex(i, &target_mask);
 			rc = 0;
 		}
+
+		/*
+		 * Trigger the HARTs updated so far before retrying as they
+		 * may have to consume data for the retry to succeed.
+		 */
+		rc = sbi_ipi_doorbell(&doorbell);
+		if (rc)
+			goto done;
 	} while (retry_needed);
 
 done:
+	/* Trigger HARTs updated before a failure, keeping the first error */
+	ret = sbi_ipi_doorbell(&doorbell);
+	if (!rc)
+		rc = ret;
+
 	/* Sync IPIs */
 	sbi_ipi_sync(scratch, event);
 
@@ -271,6 +417,34 @@ int sbi_ipi_raw_send(u32 hartindex)
 	return 0;
 }
 
+int sbi_ipi_raw_send_mask(const struct sbi_hartmask *mask)
+{
+	u32 i;
+
+	if (!ipi_dev || (!ipi_dev->ipi_send && !ipi_dev->ipi_send_mask))
+		return SBI_EINVAL;
+
+	if (find_first_bit(mask->bits, SBI_HARTMASK_MAX_BITS) >=
+	    SBI_HARTMASK_MAX_BITS)
+		return 0;
+
+	/*
+	 * Single barrier for all target HARTs, same ordering
+	 * rules as sbi_ipi_raw_send().
+	 */
+	wmb();
+
+	if (ipi_dev->ipi_send_mask) {
+		ipi_dev->ipi_send_mask(mask);
+		return 0;
+	}
+
+	sbi_hartmask_for_each_hartindex(i, mask)
+		ipi_dev->ipi_send(i);
+
+	return 0;
+}
+
 void sbi_ipi_raw_clear(u32 hartindex)
 {
 	if (ipi_dev && ipi_dev->ipi_clear)
@@ -307,9 +481,19 @@ int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
 	struct sbi_ipi_data *ipi_data;
 
 	if (cold_boot) {
-		ipi_data_off = sbi_scratch_alloc_offset(sizeof(*ipi_data));
+		/* IPI types are set by the sending HARTs */
+		ipi_data_off = sbi_scratch_alloc_offset_aligned(
+					sizeof(*ipi_data), sizeof(unsigned long),
+					SBI_SCRATCH_ALLOC_REMOTE);
 		if (!ipi_data_off)
 			return SBI_ENOMEM;
+#ifdef CONFIG_SBI_IPI_TREE_FANOUT
+		/* Created first so that forwarding is processed first */
+		ret = sbi_ipi_event_create(&ipi_fwd_ops);
+		if (ret < 0)
+			return ret;
+		ipi_fwd_event = ret;
+#endif
 		ret = sbi_ipi_event_create(&ipi_smode_ops);
 		if (ret < 0)
 			return ret;
@@ -328,6 +512,9 @@ int sbi_ipi_init(struct sbi_scratch *scratch, bool cold_boot)
 
 	ipi_data = sbi_scratch_offset_ptr(scratch, ipi_data_off);
 	ipi_data->ipi_type = 0x00;
+#ifdef CONFIG_SBI_IPI_TREE_FANOUT
+	sbi_hartmask_clear_all(&ipi_data->fwd_mask);
+#endif
 
 	/*
 	 * Initialize platform IPI support. This will also clear any
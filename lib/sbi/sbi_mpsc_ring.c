@@ -0,0 +1,126 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Lock-free multi-producer/single-consumer ring
+ *
+ * Each slot carries a sequence number next to the entry data. A slot at
+ * ring position "pos" is free for the producer when its sequence equals
+ * "pos" and holds a published entry when its sequence equals "pos + 1".
+ * After consuming it, the consumer hands the slot over to the producer
+ * of the next lap by setting the sequence to "pos + num_entries".
+ */
+
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_barrier.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_mpsc_ring.h>
+#include <sbi/sbi_string.h>
+
+static inline volatile unsigned long *ring_slot_seq(struct sbi_mpsc_ring *ring,
+						     unsigned long pos)
+{
+	unsigned long index = pos & (ring->num_entries - 1);
+
+	return (volatile unsigned long *)
+		((char *)ring->queue + index * ring->slot_size);
+}
+
+static inline void *ring_slot_data(volatile unsigned long *seq)
+{
+	return (void *)(seq + 1);
+}
+
+int sbi_mpsc_ring_init(struct sbi_mpsc_ring *ring, void *queue_mem,
+		       u16 entries, u16 entry_size)
+{
+	unsigned long i;
+
+	if (!ring || !queue_mem || !entries || (entries & (entries - 1)))
+		return SBI_EINVAL;
+
+	ring->queue	  = queue_mem;
+	ring->num_entries = entries;
+	ring->entry_size  = entry_size;
+	ring->slot_size	  = SBI_MPSC_RING_SLOT_SIZE(entry_size);
+	ring->tail	  = 0;
+	sbi_memset(ring->queue, 0, (size_t)entries * ring->slot_size);
+	for (i = 0; i < entries; i++)
+		*ring_slot_seq(ring, i) = i;
+
+	/* Publish the slot sequences before any producer sees the head */
+	smp_wmb();
+	ATOMIC_INIT(&ring->head, 0);
+
+	return 0;
+}
+
+bool sbi_mpsc_ring_is_empty(struct sbi_mpsc_ring *ring)
+{
+	unsigned long seq;
+
+	if (!ring)
+		return true;
+
+	seq = __smp_load_acquire(ring_slot_seq(ring, ring->tail));
+
+	return (seq != ring->tail + 1) ? true : false;
+}
+
+int sbi_mpsc_ring_enqueue(struct sbi_mpsc_ring *ring, void *data)
+{
+	volatile unsigned long *slot;
+	unsigned long pos, seq;
+	long diff;
+
+	if (!ring || !data)
+		return SBI_EINVAL;
+
+	pos = atomic_read(&ring->head);
+	while (1) {
+		slot = ring_slot_seq(ring, pos);
+		seq = __smp_load_acquire(slot);
+		diff = (long)(seq - pos);
+
+		if (!diff) {
+			/* Slot is free in this lap, try to reserve it */
+			if (atomic_cmpxchg(&ring->head, pos, pos + 1) == pos)
+				break;
+		} else if (diff < 0) {
+			/* Consumer has not released this slot yet */
+			return SBI_ENOSPC;
+		}
+
+		/* Another producer won the slot, retry with the new head */
+		pos = atomic_read(&ring->head);
+	}
+
+	sbi_memcpy(ring_slot_data(slot), data, ring->entry_size);
+	__smp_store_release(slot, pos + 1);
+
+	return 0;
+}
+
+int sbi_mpsc_ring_dequeue(struct sbi_mpsc_ring *ring, void *data)
+{
+	volatile unsigned long *slot;
+	unsigned long pos;
+
+	if (!ring || !data)
+		return SBI_EINVAL;
+
+	pos = ring->tail;
+	slot = ring_slot_seq(ring, pos);
+
+	/*
+	 * A reserved but not yet published slot also reads as empty, so
+	 * entries are always consumed in reservation order.
+	 */
+	if (__smp_load_acquire(slot) != pos + 1)
+		return SBI_ENOENT;
+
+	sbi_memcpy(data, ring_slot_data(slot), ring->entry_size);
+	ring->tail = pos + 1;
+	__smp_store_release(slot, pos + ring->num_entries);
+
+	return 0;
+}
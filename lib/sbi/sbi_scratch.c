@@ -8,6 +8,8 @@
  */
 
 #include <sbi/riscv_locks.h>
+#include <sbi/sbi_bitmap.h>
+#include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_platform.h>
@@ -18,8 +20,18 @@ u32 last_hartindex_having_scratch = 0;
 u32 hartindex_to_hartid_table[SBI_HARTMASK_MAX_BITS + 1] = { -1U };
 struct sbi_scratch *hartindex_to_scratch_table[SBI_HARTMASK_MAX_BITS + 1] = { 0 };
 
+/*
+ * The extra space is allocated in units of pointer size. A unit is
+ * marked in extra_used while allocated and the last unit of each
+ * allocation is also marked in extra_end so that a free-ed offset
+ * gives back the whole allocation.
+ */
+#define EXTRA_UNIT		__SIZEOF_POINTER__
+#define EXTRA_UNITS		(SBI_SCRATCH_SIZE / EXTRA_UNIT)
+
 static spinlock_t extra_lock = SPIN_LOCK_INITIALIZER;
-static unsigned long extra_offset = SBI_SCRATCH_EXTRA_SPACE_OFFSET;
+static DECLARE_BITMAP(extra_used, EXTRA_UNITS);
+static DECLARE_BITMAP(extra_end, EXTRA_UNITS);
 
 u32 sbi_hartid_to_hartindex(u32 hartid)
 {
@@ -44,6 +56,12 @@ int sbi_scratch_init(struct sbi_scratch *scratch)
 		hartindex_to_hartid_table[i] = h;
 		hartindex_to_scratch_table[i] =
 			((hartid2scratch)scratch->hartid_to_scratch)(h, i);
+#ifdef CONFIG_SBI_SCRATCH_REMOTE_ISOLATION
+		/* Offsets are placed in cache lines relative to the base */
+		if ((unsigned long)hartindex_to_scratch_table[i] &
+		    (SBI_SCRATCH_CACHE_LINE_SIZE - 1))
+			return SBI_EINVAL;
+#endif
 	}
 
 	last_hartindex_having_scratch = plat->hart_count - 1;
@@ -51,37 +69,62 @@ int sbi_scratch_init(struct sbi_scratch *scratch)
 	return 0;
 }
 
-unsigned long sbi_scratch_alloc_offset(unsigned long size)
+static bool extra_units_free(unsigned long offset, unsigned long size)
+{
+	unsigned long i;
+
+	for (i = offset / EXTRA_UNIT; i < (offset + size) / EXTRA_UNIT; i++) {
+		if (bitmap_test(extra_used, i))
+			return false;
+	}
+
+	return true;
+}
+
+unsigned long sbi_scratch_alloc_offset_aligned(unsigned long size,
+					       unsigned long align,
+					       unsigned long flags)
 {
 	u32 i;
 	void *ptr;
-	unsigned long ret = 0;
+	unsigned long off, ret = 0;
 	struct sbi_scratch *rscratch;
 
 	/*
-	 * We have a simple brain-dead allocator which never expects
-	 * anything to be free-ed hence it keeps incrementing the
-	 * next allocation offset until it runs-out of space.
-	 *
-	 * In future, we will have more sophisticated allocator which
-	 * will allow us to re-claim free-ed space.
+	 * First-fit over the extra space so that free-ed space gets
+	 * re-claimed by later allocations.
 	 */
 
-	if (!size)
+	if (!size || (align & (align - 1)))
 		return 0;
 
-	size += __SIZEOF_POINTER__ - 1;
-	size &= ~((unsigned long)__SIZEOF_POINTER__ - 1);
+	if (align < EXTRA_UNIT)
+		align = EXTRA_UNIT;
+#ifdef CONFIG_SBI_SCRATCH_REMOTE_ISOLATION
+	if (flags & SBI_SCRATCH_ALLOC_REMOTE) {
+		if (align < SBI_SCRATCH_CACHE_LINE_SIZE)
+			align = SBI_SCRATCH_CACHE_LINE_SIZE;
+		size = ROUNDUP(size, SBI_SCRATCH_CACHE_LINE_SIZE);
+	} else {
+		size = ROUNDUP(size, EXTRA_UNIT);
+	}
+#else
+	size = ROUNDUP(size, EXTRA_UNIT);
+#endif
 
 	spin_lock(&extra_lock);
 
-	if (SBI_SCRATCH_SIZE < (extra_offset + size))
-		goto done;
-
-	ret = extra_offset;
-	extra_offset += size;
+	for (off = ROUNDUP(SBI_SCRATCH_EXTRA_SPACE_OFFSET, align);
+	     off + size <= SBI_SCRATCH_SIZE; off += align) {
+		if (extra_units_free(off, size)) {
+			bitmap_set(extra_used, off / EXTRA_UNIT,
+				   size / EXTRA_UNIT);
+			bitmap_set(extra_end, (off + size) / EXTRA_UNIT - 1, 1);
+			ret = off;
+			break;
+		}
+	}
 
-done:
 	spin_unlock(&extra_lock);
 
 	if (ret) {
@@ -97,24 +140,51 @@ done:
 	return ret;
 }
 
+unsigned long sbi_scratch_alloc_offset(unsigned long size)
+{
+	return sbi_scratch_alloc_offset_aligned(size, EXTRA_UNIT, 0);
+}
+
 void sbi_scratch_free_offset(unsigned long offset)
 {
+	unsigned long i;
+
 	if ((offset < SBI_SCRATCH_EXTRA_SPACE_OFFSET) ||
-	    (SBI_SCRATCH_SIZE <= offset))
+	    (SBI_SCRATCH_SIZE <= offset) || (offset & (EXTRA_UNIT - 1)))
 		return;
 
-	/*
-	 * We don't actually free-up because it's a simple
-	 * brain-dead allocator.
-	 */
+	spin_lock(&extra_lock);
+
+	/* Only the start of an allocation can be free-ed */
+	i = offset / EXTRA_UNIT;
+	if (!bitmap_test(extra_used, i) ||
+	    ((offset != SBI_SCRATCH_EXTRA_SPACE_OFFSET) &&
+	     bitmap_test(extra_used, i - 1) && !bitmap_test(extra_end, i - 1)))
+		goto done;
+
+	for (; i < EXTRA_UNITS; i++) {
+		bitmap_clear(extra_used, i, 1);
+		if (bitmap_test(extra_end, i)) {
+			bitmap_clear(extra_end, i, 1);
+			break;
+		}
+	}
+
+done:
+	spin_unlock(&extra_lock);
 }
 
 unsigned long sbi_scratch_used_space(void)
 {
-	unsigned long ret = 0;
+	unsigned long i, ret = SBI_SCRATCH_EXTRA_SPACE_OFFSET;
 
 	spin_lock(&extra_lock);
-	ret = extra_offset;
+	for (i = EXTRA_UNITS; ret / EXTRA_UNIT < i; i--) {
+		if (bitmap_test(extra_end, i - 1)) {
+			ret = i * EXTRA_UNIT;
+			break;
+		}
+	}
 	spin_unlock(&extra_lock);
 
 	return ret;
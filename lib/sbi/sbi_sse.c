@@ -876,19 +876,6 @@ int sbi_sse_attr_check(uint32_t base_attr_id, uint32_t attr_count,
 	return SBI_OK;
 }
 
-static void copy_attrs(unsigned long *out, const unsigned long *in,
-		       unsigned int long_count)
-{
-	int i = 0;
-
-	/*
-	 * sbi_memcpy() does byte-per-byte copy, using this yields long-per-long
-	 * copy
-	 */
-	for (i = 0; i < long_count; i++)
-		out[i] = in[i];
-}
-
 int sbi_sse_read_attrs(uint32_t event_id, uint32_t base_attr_id,
 		       uint32_t attr_count, unsigned long output_phys_lo,
 		       unsigned long output_phys_hi)
@@ -896,7 +883,6 @@ int sbi_sse_read_attrs(uint32_t event_id, uint32_t base_attr_id,
 	int ret;
 	unsigned long *e_attrs;
 	struct sbi_sse_event *e;
-	unsigned long *attrs;
 
 	ret = sbi_sse_attr_check(base_attr_id, attr_count, output_phys_lo,
 				 output_phys_hi, SBI_DOMAIN_WRITE);
@@ -907,8 +893,6 @@ int sbi_sse_read_attrs(uint32_t event_id, uint32_t base_attr_id,
 	if (!e)
 		return SBI_EINVAL;
 
-	sbi_hart_map_saddr(output_phys_lo, sizeof(unsigned long) * attr_count);
-
 	/*
 	 * Copy all attributes at once since struct sse_event_attrs is matching
 	 * the SBI_SSE_ATTR_* attributes. READ_ATTR is used in SSE handling path
@@ -917,14 +901,12 @@ int sbi_sse_read_attrs(uint32_t event_id, uint32_t base_attr_id,
 	 * them all at once.
 	 */
 	e_attrs = (unsigned long *)&e->attrs;
-	attrs = (unsigned long *)output_phys_lo;
-	copy_attrs(attrs, &e_attrs[base_attr_id], attr_count);
-
-	sbi_hart_unmap_saddr();
+	ret = sbi_hart_copy_to_saddr(output_phys_lo, &e_attrs[base_attr_id],
+				     sizeof(unsigned long) * attr_count);
 
 	sse_event_put(e);
 
-	return SBI_OK;
+	return ret;
 }
 
 static int sse_write_attrs(struct sbi_sse_event *e, uint32_t base_attr_id,
@@ -933,15 +915,22 @@ static int sse_write_attrs(struct sbi_sse_event *e, uint32_t base_attr_id,
 	int ret = 0;
 	unsigned long attr = 0, val;
 	uint32_t id, end_id = base_attr_id + attr_count;
-	unsigned long *attrs = (unsigned long *)input_phys;
+	unsigned long attrs[SBI_SSE_ATTR_MAX];
 
-	sbi_hart_map_saddr(input_phys, sizeof(unsigned long) * attr_count);
+	/*
+	 * Copy the attributes once so that the values which are checked
+	 * are the ones which are set.
+	 */
+	ret = sbi_hart_copy_from_saddr(attrs, input_phys,
+				       sizeof(unsigned long) * attr_count);
+	if (ret)
+		return ret;
 
 	for (id = base_attr_id; id < end_id; id++) {
 		val = attrs[attr++];
 		ret = sse_event_set_attr_check(e, id, val);
 		if (ret)
-			goto out;
+			return ret;
 	}
 
 	attr = 0;
@@ -950,10 +939,7 @@ static int sse_write_attrs(struct sbi_sse_event *e, uint32_t base_attr_id,
 		sse_event_set_attr(e, id, val);
 	}
 
-out:
-	sbi_hart_unmap_saddr();
-
-	return ret;
+	return 0;
 }
 
 int sbi_sse_write_attrs(uint32_t event_id, uint32_t base_attr_id,
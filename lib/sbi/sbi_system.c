@@ -11,13 +11,16 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall.h>
 #include <sbi/sbi_hart.h>
+#include <sbi/sbi_heap.h>
 #include <sbi/sbi_hsm.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_system.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi/sbi_init.h>
 #include <sbi/sbi_timer.h>
+#include <sbi/sbi_trap_stats.h>
 
 static SBI_LIST_HEAD(reset_devices_list);
 
@@ -80,6 +83,10 @@ void __noreturn sbi_system_reset(u32 reset_type, u32 reset_reason)
 		hbase += BITS_PER_LONG;
 	}
 
+	sbi_ecall_stats_dump();
+	sbi_trap_stats_dump();
+	sbi_heap_stats_dump();
+
 	/* Stop current HART */
 	sbi_hsm_hart_stop(scratch, false);
 
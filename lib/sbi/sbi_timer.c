@@ -10,6 +10,7 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_barrier.h>
 #include <sbi/riscv_encoding.h>
+#include <sbi/riscv_io.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_hart.h>
@@ -17,8 +18,17 @@
 #include <sbi/sbi_pmu.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_timer.h>
+#include <sbi/sbi_trap.h>
 
-static unsigned long time_delta_off;
+/* Per-HART timer state in the scratch space */
+struct timer_hart_state {
+	/** Offset of the VS/VU-mode time from the timer value */
+	u64 time_delta;
+	/** Cached MMIO address of the timer (NULL if not usable) */
+	volatile u64 *mtime;
+};
+
+static unsigned long timer_hart_off;
 static u64 (*get_time_val)(void);
 static const struct sbi_timer_device *timer_dev = NULL;
 
@@ -89,6 +99,12 @@ bool sbi_timer_waitms_until(bool (*predicate)(void *), void *arg,
 	return true;
 }
 
+static inline struct timer_hart_state *timer_hart_thishart(void)
+{
+	return sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
+				      timer_hart_off);
+}
+
 u64 sbi_timer_value(void)
 {
 	if (get_time_val)
@@ -98,35 +114,83 @@ u64 sbi_timer_value(void)
 
 u64 sbi_timer_virt_value(void)
 {
-	u64 *time_delta = sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
-						 time_delta_off);
+	struct timer_hart_state *ts = timer_hart_thishart();
 
-	return sbi_timer_value() + *time_delta;
+	return sbi_timer_value() + ts->time_delta;
 }
 
 u64 sbi_timer_get_delta(void)
 {
-	u64 *time_delta = sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
-						 time_delta_off);
-
-	return *time_delta;
+	return timer_hart_thishart()->time_delta;
 }
 
 void sbi_timer_set_delta(ulong delta)
 {
-	u64 *time_delta = sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
-						 time_delta_off);
-
-	*time_delta = (u64)delta;
+	timer_hart_thishart()->time_delta = (u64)delta;
 }
 
 void sbi_timer_set_delta_upper(ulong delta_upper)
 {
-	u64 *time_delta = sbi_scratch_offset_ptr(sbi_scratch_thishart_ptr(),
-						 time_delta_off);
+	struct timer_hart_state *ts = timer_hart_thishart();
+
+	ts->time_delta &= 0xffffffffULL;
+	ts->time_delta |= ((u64)delta_upper << 32);
+}
+
+/*
+ * Fast path for S-mode reading the TIME CSR on harts without a readable
+ * time CSR, which is hot because of sched_clock(). Only the exact rdtime
+ * (or rdtimeh) encoding reported in MTVAL is handled, the timer is read
+ * through the cached MMIO address and everything else falls back to the
+ * generic CSR emulation.
+ */
+bool sbi_timer_emulate_rdtime(struct sbi_trap_regs *regs, ulong insn)
+{
+	struct timer_hart_state *ts;
+	volatile u64 *mtime;
+	u64 val;
+#if __riscv_xlen == 32
+	bool virt = (regs->mstatusH & MSTATUSH_MPV) ? true : false;
+	u32 lo, hi;
+
+	if ((insn & INSN_MASK_RDTIME) != INSN_MATCH_RDTIME &&
+	    (insn & INSN_MASK_RDTIME) != INSN_MATCH_RDTIMEH)
+		return false;
+#else
+	bool virt = (regs->mstatus & MSTATUS_MPV) ? true : false;
 
-	*time_delta &= 0xffffffffULL;
-	*time_delta |= ((u64)delta_upper << 32);
+	if ((insn & INSN_MASK_RDTIME) != INSN_MATCH_RDTIME)
+		return false;
+#endif
+
+	if (((regs->mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT) == PRV_M)
+		return false;
+
+	ts = timer_hart_thishart();
+	mtime = ts->mtime;
+	if (!mtime)
+		return false;
+
+#if __riscv_xlen == 32
+	do {
+		hi = readl_relaxed((u32 *)mtime + 1);
+		lo = readl_relaxed((u32 *)mtime);
+	} while (hi != readl_relaxed((u32 *)mtime + 1));
+	val = ((u64)hi << 32) | lo;
+#else
+	val = readq_relaxed(mtime);
+#endif
+	if (virt)
+		val += ts->time_delta;
+
+#if __riscv_xlen == 32
+	if ((insn & INSN_MASK_RDTIME) == INSN_MATCH_RDTIMEH)
+		val >>= 32;
+#endif
+	SET_RD(insn, regs, (ulong)val);
+	regs->mepc += 4;
+
+	return true;
 }
 
 void sbi_timer_event_start(u64 next_event)
@@ -180,25 +244,36 @@ void sbi_timer_set_device(const struct sbi_timer_device *dev)
 
 int sbi_timer_init(struct sbi_scratch *scratch, bool cold_boot)
 {
-	u64 *time_delta;
+	int rc;
+	struct timer_hart_state *ts;
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
-		time_delta_off = sbi_scratch_alloc_offset(sizeof(*time_delta));
-		if (!time_delta_off)
+		timer_hart_off = sbi_scratch_alloc_offset(sizeof(*ts));
+		if (!timer_hart_off)
 			return SBI_ENOMEM;
 
 		if (sbi_hart_has_extension(scratch, SBI_HART_EXT_ZICNTR))
 			get_time_val = get_ticks;
 	} else {
-		if (!time_delta_off)
+		if (!timer_hart_off)
 			return SBI_ENOMEM;
 	}
 
-	time_delta = sbi_scratch_offset_ptr(scratch, time_delta_off);
-	*time_delta = 0;
+	ts = sbi_scratch_offset_ptr(scratch, timer_hart_off);
+	ts->time_delta = 0;
+	ts->mtime = NULL;
 
-	return sbi_platform_timer_init(plat, cold_boot);
+	rc = sbi_platform_timer_init(plat, cold_boot);
+	if (rc)
+		return rc;
+
+	/* Cache the timer address only if it backs the timer value */
+	if (timer_dev && timer_dev->timer_value_addr &&
+	    get_time_val == timer_dev->timer_value)
+		ts->mtime = timer_dev->timer_value_addr();
+
+	return 0;
 }
 
 void sbi_timer_exit(struct sbi_scratch *scratch)
@@ -11,14 +11,22 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_atomic.h>
 #include <sbi/riscv_barrier.h>
+#include <sbi/riscv_locks.h>
+#include <sbi/sbi_bitmap.h>
+#include <sbi/sbi_domain.h>
+#include <sbi/sbi_ecall_interface.h>
 #include <sbi/sbi_error.h>
 #include <sbi/sbi_fifo.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_heap.h>
+#include <sbi/sbi_insn_cache.h>
 #include <sbi/sbi_ipi.h>
+#include <sbi/sbi_math.h>
+#include <sbi/sbi_mpsc_ring.h>
 #include <sbi/sbi_scratch.h>
 #include <sbi/sbi_tlb.h>
 #include <sbi/sbi_hfence.h>
+#include <sbi/sbi_svinval.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_console.h>
 #include <sbi/sbi_platform.h>
@@ -27,13 +35,228 @@
 static unsigned long tlb_sync_off;
 static unsigned long tlb_fifo_off;
 static unsigned long tlb_fifo_mem_off;
-static unsigned long tlb_range_flush_limit;
+static unsigned long tlb_done_off;
+#ifdef CONFIG_SBI_TLB_FLUSH_GEN
+static unsigned long tlb_gen_off;
+#endif
+#ifdef CONFIG_SBI_TLB_MULTICAST
+static unsigned long tlb_desc_off;
+#endif
+#ifdef CONFIG_SBI_TLB_ASYNC
+static unsigned long tlb_async_off;
+#endif
+static unsigned long tlb_range_flush_limit[SBI_TLB_TYPE_MAX];
+static unsigned long tlb_range_flush_limit_fixed;
+static bool tlb_range_flush_limit_measured;
+
+/*
+ * With Svinval, a range is invalidated using a batch of SINVAL/HINVAL
+ * instructions between one pair of ordering fences instead of a fully
+ * ordered fence per page, so larger ranges remain cheaper than a full
+ * flush.
+ */
+#define TLB_SVINVAL_FLUSH_LIMIT_SHIFT	3
+
+/* Bounds of the polling backoff while waiting without Zawrs */
+#define TLB_WAIT_SPINS_MIN		16
+#define TLB_WAIT_SPINS_MAX		1024
 
 static void tlb_flush_all(void)
 {
 	__asm__ __volatile("sfence.vma");
 }
 
+#ifdef CONFIG_SBI_TLB_FLUSH_GEN
+
+/* Number of ASIDs and VMIDs tracked per HART for each kind of fence */
+#define TLB_GEN_TABLE_SIZE		16
+
+struct tlb_gen_entry {
+	unsigned long id;
+	unsigned long gen;
+};
+
+/*
+ * Per-HART record of the flush generation at which full flushes were
+ * last done. A generation of zero means no such flush was recorded.
+ * ASID/VMID entries live in small direct mapped tables so a colliding
+ * ID just evicts the older record.
+ */
+struct tlb_flush_gen {
+	unsigned long vma_all;
+	unsigned long gvma_all;
+	struct tlb_gen_entry vma_asid[TLB_GEN_TABLE_SIZE];
+	struct tlb_gen_entry gvma_vmid[TLB_GEN_TABLE_SIZE];
+	struct tlb_gen_entry vvma_vmid[TLB_GEN_TABLE_SIZE];
+};
+
+/* Allocations are rounded up to 64 bytes by the heap */
+_Static_assert(ROUNDUP(sizeof(struct tlb_flush_gen), 64) <=
+	       SBI_TLB_FLUSH_GEN_HEAP_SIZE,
+	       "SBI_TLB_FLUSH_GEN_HEAP_SIZE is too small for tlb_flush_gen");
+
+/* Global flush generation, advanced by each remote fence request */
+static atomic_t tlb_flush_seq = ATOMIC_INITIALIZER(0);
+
+static unsigned long tlb_gen_lookup(struct tlb_gen_entry *table,
+				    unsigned long id)
+{
+	struct tlb_gen_entry *e = &table[id % TLB_GEN_TABLE_SIZE];
+
+	return (e->id == id) ? e->gen : 0;
+}
+
+static void tlb_gen_record(struct tlb_gen_entry *table,
+			   unsigned long id, unsigned long gen)
+{
+	struct tlb_gen_entry *e = &table[id % TLB_GEN_TABLE_SIZE];
+
+	e->id = id;
+	e->gen = gen;
+}
+
+static bool tlb_gen_covered(struct tlb_flush_gen *fg,
+			    struct sbi_tlb_info *tinfo)
+{
+	unsigned long gen = tinfo->gen;
+
+	if (!gen)
+		return false;
+
+	switch (tinfo->type) {
+	case SBI_TLB_SFENCE_VMA:
+		return fg->vma_all >= gen;
+	case SBI_TLB_SFENCE_VMA_ASID:
+		return fg->vma_all >= gen ||
+		       tlb_gen_lookup(fg->vma_asid, tinfo->asid) >= gen;
+	case SBI_TLB_HFENCE_GVMA:
+		return fg->gvma_all >= gen;
+	case SBI_TLB_HFENCE_GVMA_VMID:
+		return fg->gvma_all >= gen ||
+		       tlb_gen_lookup(fg->gvma_vmid, tinfo->vmid) >= gen;
+	case SBI_TLB_HFENCE_VVMA:
+	case SBI_TLB_HFENCE_VVMA_ASID:
+		return tlb_gen_lookup(fg->vvma_vmid, tinfo->vmid) >= gen;
+	default:
+		return false;
+	}
+}
+
+static void tlb_gen_update(struct tlb_flush_gen *fg,
+			   struct sbi_tlb_info *tinfo, unsigned long gen)
+{
+	switch (tinfo->type) {
+	case SBI_TLB_SFENCE_VMA:
+		fg->vma_all = gen;
+		break;
+	case SBI_TLB_SFENCE_VMA_ASID:
+		tlb_gen_record(fg->vma_asid, tinfo->asid, gen);
+		break;
+	case SBI_TLB_HFENCE_GVMA:
+		fg->gvma_all = gen;
+		break;
+	case SBI_TLB_HFENCE_GVMA_VMID:
+		tlb_gen_record(fg->gvma_vmid, tinfo->vmid, gen);
+		break;
+	case SBI_TLB_HFENCE_VVMA:
+		tlb_gen_record(fg->vvma_vmid, tinfo->vmid, gen);
+		break;
+	default:
+		break;
+	}
+}
+
+static inline struct tlb_flush_gen *tlb_gen_thishart(void)
+{
+	return sbi_scratch_read_type(sbi_scratch_thishart_ptr(), void *,
+				     tlb_gen_off);
+}
+
+/*
+ * Check a request against the full flushes recorded by this HART.
+ * Returns true if the request was already covered, otherwise sets *gen
+ * to the generation to record once the request is processed.
+ */
+static bool tlb_gen_skip(struct sbi_tlb_info *data, unsigned long *gen)
+{
+	struct tlb_flush_gen *fg = tlb_gen_thishart();
+
+	*gen = 0;
+	if (!fg)
+		return false;
+
+	if ((data->start == 0 && data->size == 0) ||
+	    (data->size == SBI_TLB_FLUSH_ALL)) {
+		/*
+		 * Any request stamped with a generation up to the one
+		 * observed here was issued before this flush.
+		 */
+		*gen = __smp_load_acquire(&tlb_flush_seq.counter);
+	} else if (data->type != SBI_TLB_FENCE_I) {
+		if (tlb_gen_covered(fg, data)) {
+			sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TLB_GEN_HIT);
+			return true;
+		}
+		sbi_pmu_ctr_incr_fw(SBI_PMU_FW_TLB_GEN_MISS);
+	}
+
+	return false;
+}
+
+static void tlb_gen_flushed(struct sbi_tlb_info *data, unsigned long gen)
+{
+	if (gen)
+		tlb_gen_update(tlb_gen_thishart(), data, gen);
+}
+
+static inline unsigned long tlb_gen_stamp(void)
+{
+	return atomic_add_return(&tlb_flush_seq, 1);
+}
+
+static int tlb_gen_hart_init(struct sbi_scratch *scratch)
+{
+	struct tlb_flush_gen *fg;
+
+	if (!sbi_scratch_read_type(scratch, void *, tlb_gen_off)) {
+		fg = sbi_zalloc(sizeof(*fg));
+		if (!fg)
+			return SBI_ENOMEM;
+		sbi_scratch_write_type(scratch, void *, tlb_gen_off, fg);
+	}
+
+	return 0;
+}
+
+#else
+
+static inline bool tlb_gen_skip(struct sbi_tlb_info *data, unsigned long *gen)
+{
+	*gen = 0;
+	return false;
+}
+
+static inline void tlb_gen_flushed(struct sbi_tlb_info *data,
+				   unsigned long gen) { }
+
+static inline unsigned long tlb_gen_stamp(void)
+{
+	return 0;
+}
+
+static inline int tlb_gen_hart_init(struct sbi_scratch *scratch)
+{
+	return 0;
+}
+
+#endif
+
+static inline bool tlb_has_svinval(void)
+{
+	return sbi_hart_has_extension(sbi_scratch_thishart_ptr(),
+				      SBI_HART_EXT_SVINVAL);
+}
+
 static void sbi_tlb_local_hfence_vvma(struct sbi_tlb_info *tinfo)
 {
 	unsigned long start = tinfo->start;
@@ -51,6 +274,14 @@ static void sbi_tlb_local_hfence_vvma(struct sbi_tlb_info *tinfo)
 		goto done;
 	}
 
+	if (tlb_has_svinval()) {
+		__sbi_sfence_w_inval();
+		for (i = 0; i < size; i += PAGE_SIZE)
+			__sbi_hinval_vvma_va(start + i);
+		__sbi_sfence_inval_ir();
+		goto done;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__sbi_hfence_vvma_va(start+i);
 	}
@@ -72,6 +303,14 @@ static void sbi_tlb_local_hfence_gvma(struct sbi_tlb_info *tinfo)
 		return;
 	}
 
+	if (tlb_has_svinval()) {
+		__sbi_sfence_w_inval();
+		for (i = 0; i < size; i += PAGE_SIZE)
+			__sbi_hinval_gvma_gpa((start + i) >> 2);
+		__sbi_sfence_inval_ir();
+		return;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__sbi_hfence_gvma_gpa((start + i) >> 2);
 	}
@@ -90,6 +329,14 @@ static void sbi_tlb_local_sfence_vma(struct sbi_tlb_info *tinfo)
 		return;
 	}
 
+	if (tlb_has_svinval()) {
+		__sbi_sfence_w_inval();
+		for (i = 0; i < size; i += PAGE_SIZE)
+			__sbi_sinval_vma_va(start + i);
+		__sbi_sfence_inval_ir();
+		return;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__asm__ __volatile__("sfence.vma %0"
 				     :
@@ -116,6 +363,14 @@ static void sbi_tlb_local_hfence_vvma_asid(struct sbi_tlb_info *tinfo)
 		goto done;
 	}
 
+	if (tlb_has_svinval()) {
+		__sbi_sfence_w_inval();
+		for (i = 0; i < size; i += PAGE_SIZE)
+			__sbi_hinval_vvma_asid_va(start + i, asid);
+		__sbi_sfence_inval_ir();
+		goto done;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__sbi_hfence_vvma_asid_va(start + i, asid);
 	}
@@ -138,6 +393,14 @@ static void sbi_tlb_local_hfence_gvma_vmid(struct sbi_tlb_info *tinfo)
 		return;
 	}
 
+	if (tlb_has_svinval()) {
+		__sbi_sfence_w_inval();
+		for (i = 0; i < size; i += PAGE_SIZE)
+			__sbi_hinval_gvma_vmid_gpa((start + i) >> 2, vmid);
+		__sbi_sfence_inval_ir();
+		return;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__sbi_hfence_gvma_vmid_gpa((start + i) >> 2, vmid);
 	}
@@ -161,6 +424,14 @@ static void sbi_tlb_local_sfence_vma_asid(struct sbi_tlb_info *tinfo)
 		return;
 	}
 
+	if (tlb_has_svinval()) {
+		__sbi_sfence_w_inval();
+		for (i = 0; i < size; i += PAGE_SIZE)
+			__sbi_sinval_vma_asid_va(start + i, asid);
+		__sbi_sfence_inval_ir();
+		return;
+	}
+
 	for (i = 0; i < size; i += PAGE_SIZE) {
 		__asm__ __volatile__("sfence.vma %0, %1"
 				     :
@@ -178,9 +449,14 @@ static void sbi_tlb_local_fence_i(struct sbi_tlb_info *tinfo)
 
 static void tlb_entry_local_process(struct sbi_tlb_info *data)
 {
-	if (unlikely(!data))
+	unsigned long gen;
+
+	if (unlikely(!data) || tlb_gen_skip(data, &gen))
 		return;
 
+	/* Instructions cached for trap emulation may have changed */
+	sbi_insn_cache_flush();
+
 	switch (data->type) {
 	case SBI_TLB_FENCE_I:
 		sbi_tlb_local_fence_i(data);
@@ -206,61 +482,386 @@ static void tlb_entry_local_process(struct sbi_tlb_info *data)
 	default:
 		break;
 	};
+
+	tlb_gen_flushed(data, gen);
 }
 
-static void tlb_entry_process(struct sbi_tlb_info *tinfo)
+#ifdef CONFIG_SBI_TLB_ASYNC
+
+/** Asynchronous remote fence state of a HART */
+struct tlb_async {
+	spinlock_t lock;
+	/** Physical address of the ring shared with S-mode (0 if none) */
+	unsigned long addr;
+	unsigned long num_entries;
+	/** Ring position up to which descriptors have been submitted */
+	unsigned long posted;
+	/** Ring position last reported as done to S-mode */
+	unsigned long done;
+	/** Set while the doorbell submits descriptors of the ring */
+	bool submitting;
+};
+
+/*
+ * Report all submitted descriptors of the ring as done. Called once the
+ * pending count of the sending HART dropped to zero, possibly from a
+ * receiving HART.
+ */
+static void tlb_async_complete(struct sbi_scratch *scratch)
 {
-	u32 rindex;
-	struct sbi_scratch *rscratch = NULL;
-	atomic_t *rtlb_sync = NULL;
+	struct tlb_async *async = sbi_scratch_offset_ptr(scratch, tlb_async_off);
+	struct sbi_rfence_ring_header *hdr;
 
-	tlb_entry_local_process(tinfo);
+	if (async->done == async->posted)
+		return;
 
-	sbi_hartmask_for_each_hartindex(rindex, &tinfo->smask) {
-		rscratch = sbi_hartindex_to_scratch(rindex);
-		if (!rscratch)
+	spin_lock(&async->lock);
+
+	/*
+	 * The sending HART may have submitted more descriptors since the
+	 * pending count dropped to zero. It holds an extra count while
+	 * doing so, hence a zero count means the latest "posted" is done.
+	 */
+	if (async->addr && async->done != async->posted &&
+	    !atomic_read(sbi_scratch_offset_ptr(scratch, tlb_sync_off))) {
+		hdr = (struct sbi_rfence_ring_header *)async->addr;
+		sbi_hart_map_saddr(async->addr, sizeof(*hdr));
+		__smp_store_release(&hdr->done, async->posted);
+		sbi_hart_unmap_saddr();
+		async->done = async->posted;
+	}
+
+	spin_unlock(&async->lock);
+}
+
+#else
+
+static inline void tlb_async_complete(struct sbi_scratch *scratch) { }
+
+#endif
+
+/* Release one pending remote fence request of the sending HART */
+static void tlb_sync_put(struct sbi_scratch *scratch)
+{
+	atomic_t *tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+
+	if (!atomic_sub_return(tlb_sync, 1))
+		tlb_async_complete(scratch);
+}
+
+/*
+ * Merge the senders of a new request into a queued one. With asynchronous
+ * remote fences a sender may already own the queued request, in which case
+ * it will be released only once for both so drop the extra pending count.
+ */
+static inline void tlb_smask_merge(struct sbi_hartmask *dst,
+				   const struct sbi_hartmask *src)
+{
+#ifdef CONFIG_SBI_TLB_ASYNC
+	u32 i;
+
+	sbi_hartmask_for_each_hartindex(i, src) {
+		if (sbi_hartmask_test_hartindex(i, dst))
+			tlb_sync_put(sbi_hartindex_to_scratch(i));
+	}
+#endif
+	sbi_hartmask_or(dst, dst, src);
+}
+
+#if defined(CONFIG_SBI_TLB_QUEUE_MPSC_RING)
+
+#define TLB_QUEUE_SIZE		sizeof(struct sbi_mpsc_ring)
+
+static u32 tlb_queue_num_entries(const struct sbi_platform *plat)
+{
+	return 1UL << log2roundup(sbi_platform_tlb_fifo_num_entries(plat));
+}
+
+static unsigned long tlb_queue_mem_size(u32 entries)
+{
+	return SBI_MPSC_RING_MEM_SIZE(entries, SBI_TLB_QUEUE_DATA_SIZE);
+}
+
+static int tlb_queue_init(void *tlb_q, void *tlb_mem, u32 entries)
+{
+	return sbi_mpsc_ring_init(tlb_q, tlb_mem, entries,
+				  SBI_TLB_QUEUE_DATA_SIZE);
+}
+
+static int tlb_queue_enqueue(void *tlb_q, void *data)
+{
+	/*
+	 * Published slots may be read by the receiver at any time so
+	 * queued entries can't be merged in-place like with the fifo.
+	 */
+	return sbi_mpsc_ring_enqueue(tlb_q, data);
+}
+
+static int tlb_queue_dequeue(void *tlb_q, void *data)
+{
+	return sbi_mpsc_ring_dequeue(tlb_q, data);
+}
+
+#elif defined(CONFIG_SBI_TLB_QUEUE_COALESCE)
+
+#define TLB_PSET_MAX_KEYS	SBI_HARTMASK_MAX_BITS
+
+/*
+ * Per-HART set of pending invalidations. Keys live in an open addressed
+ * hash table (linear probing) indexed by (type, ASID/VMID). The receiving
+ * HART drains one key at a time into the extra entry at the end of the
+ * table and then hands out one sbi_tlb_info per merged range.
+ */
+struct tlb_pset {
+	spinlock_t lock;
+	u32 num_keys;
+	struct sbi_tlb_pending *keys;
+	unsigned long used[BITS_TO_LONGS(TLB_PSET_MAX_KEYS)];
+	/* Below fields are only accessed by the receiving HART */
+	bool draining;
+	u32 drain_pos;
+};
+
+#define TLB_QUEUE_SIZE		sizeof(struct tlb_pset)
+
+static u32 tlb_queue_num_entries(const struct sbi_platform *plat)
+{
+	/*
+	 * A sender has at most one outstanding request per receiver so
+	 * one key per HART can never overflow.
+	 */
+	return MIN(sbi_platform_tlb_fifo_num_entries(plat), TLB_PSET_MAX_KEYS);
+}
+
+static unsigned long tlb_queue_mem_size(u32 entries)
+{
+	/* One extra entry used by the receiving HART for draining */
+	return (entries + 1) * sizeof(struct sbi_tlb_pending);
+}
+
+static int tlb_queue_init(void *tlb_q, void *tlb_mem, u32 entries)
+{
+	struct tlb_pset *pset = tlb_q;
+
+	if (!entries)
+		return SBI_EINVAL;
+
+	SPIN_LOCK_INIT(pset->lock);
+	pset->num_keys = entries;
+	pset->keys = tlb_mem;
+	pset->draining = false;
+	pset->drain_pos = 0;
+	bitmap_zero(pset->used, TLB_PSET_MAX_KEYS);
+	sbi_memset(tlb_mem, 0, tlb_queue_mem_size(entries));
+
+	return 0;
+}
+
+static void tlb_pset_key(struct sbi_tlb_info *tinfo, u16 *asid, u16 *vmid)
+{
+	*asid = 0;
+	*vmid = 0;
+
+	switch (tinfo->type) {
+	case SBI_TLB_SFENCE_VMA_ASID:
+		*asid = tinfo->asid;
+		break;
+	case SBI_TLB_HFENCE_VVMA_ASID:
+		*asid = tinfo->asid;
+		*vmid = tinfo->vmid;
+		break;
+	case SBI_TLB_HFENCE_GVMA_VMID:
+	case SBI_TLB_HFENCE_VVMA:
+		*vmid = tinfo->vmid;
+		break;
+	default:
+		break;
+	}
+}
+
+static u32 tlb_pset_hash(struct tlb_pset *pset, enum sbi_tlb_type type,
+			 u16 asid, u16 vmid)
+{
+	u32 key = ((u32)type << 28) ^ ((u32)vmid << 14) ^ asid;
+
+	return (key * 2654435761U) % pset->num_keys;
+}
+
+/* Note: must be called with pset->lock held */
+static void tlb_pset_delete(struct tlb_pset *pset, u32 i)
+{
+	u32 j = i, k;
+
+	__clear_bit(i, pset->used);
+
+	/* Backward shift deletion keeps probe sequences intact */
+	while (1) {
+		j = (j + 1) % pset->num_keys;
+		if (!__test_bit(j, pset->used))
+			break;
+
+		k = tlb_pset_hash(pset, pset->keys[j].type,
+				  pset->keys[j].asid, pset->keys[j].vmid);
+		if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
 			continue;
 
-		rtlb_sync = sbi_scratch_offset_ptr(rscratch, tlb_sync_off);
-		atomic_sub_return(rtlb_sync, 1);
+		pset->keys[i] = pset->keys[j];
+		__set_bit(i, pset->used);
+		__clear_bit(j, pset->used);
+		i = j;
 	}
 }
 
-static bool tlb_process_once(struct sbi_scratch *scratch)
+static void tlb_pending_add_range(struct sbi_tlb_pending *pend,
+				  unsigned long start, unsigned long size)
 {
-	struct sbi_tlb_info tinfo;
-	struct sbi_fifo *tlb_fifo =
-			sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
+	unsigned long end = start + size, total = 0;
+	u32 i, j, merged;
 
-	if (!sbi_fifo_dequeue(tlb_fifo, &tinfo)) {
-		tlb_entry_process(&tinfo);
-		return true;
+	if (pend->flush_all)
+		return;
+
+	if ((!start && !size) || size == SBI_TLB_FLUSH_ALL || end < start)
+		goto flush_all;
+
+	/* Find the first range which overlaps or is adjacent */
+	for (i = 0; i < pend->nranges && pend->end[i] < start; i++)
+		;
+
+	/* Absorb all ranges which overlap or are adjacent */
+	for (j = i; j < pend->nranges && pend->start[j] <= end; j++) {
+		start = MIN(start, pend->start[j]);
+		end = MAX(end, pend->end[j]);
 	}
+	merged = j - i;
+
+	if (!merged) {
+		if (pend->nranges == SBI_TLB_PENDING_MAX_RANGES)
+			goto flush_all;
+		for (j = pend->nranges; j > i; j--) {
+			pend->start[j] = pend->start[j - 1];
+			pend->end[j] = pend->end[j - 1];
+		}
+		pend->nranges++;
+	} else if (merged > 1) {
+		for (j = i + 1; j + merged - 1 < pend->nranges; j++) {
+			pend->start[j] = pend->start[j + merged - 1];
+			pend->end[j] = pend->end[j + merged - 1];
+		}
+		pend->nranges -= merged - 1;
+	}
+	pend->start[i] = start;
+	pend->end[i] = end;
 
-	return false;
+	for (i = 0; i < pend->nranges; i++)
+		total += pend->end[i] - pend->start[i];
+	if (total <= tlb_range_flush_limit[pend->type])
+		return;
+
+flush_all:
+	pend->flush_all = true;
+	pend->nranges = 0;
 }
 
-static void tlb_process(struct sbi_scratch *scratch)
+static int tlb_queue_enqueue(void *tlb_q, struct sbi_tlb_info *tinfo)
 {
-	while (tlb_process_once(scratch));
+	struct tlb_pset *pset = tlb_q;
+	struct sbi_tlb_pending *pend;
+	u16 asid, vmid;
+	u32 i, n;
+
+	tlb_pset_key(tinfo, &asid, &vmid);
+
+	spin_lock(&pset->lock);
+
+	i = tlb_pset_hash(pset, tinfo->type, asid, vmid);
+	for (n = 0; n < pset->num_keys; n++) {
+		pend = &pset->keys[i];
+		if (!__test_bit(i, pset->used)) {
+			sbi_memset(pend, 0, sizeof(*pend));
+			pend->type = tinfo->type;
+			pend->asid = asid;
+			pend->vmid = vmid;
+			pend->gen = tinfo->gen;
+			__set_bit(i, pset->used);
+			break;
+		}
+		if (pend->type == tinfo->type &&
+		    pend->asid == asid && pend->vmid == vmid)
+			break;
+		i = (i + 1) % pset->num_keys;
+	}
+
+	if (n == pset->num_keys) {
+		spin_unlock(&pset->lock);
+		return SBI_ENOSPC;
+	}
+
+	if (tinfo->type == SBI_TLB_FENCE_I)
+		pend->flush_all = true;
+	else
+		tlb_pending_add_range(pend, tinfo->start, tinfo->size);
+	pend->gen = MAX(pend->gen, tinfo->gen);
+	tlb_smask_merge(&pend->smask, &tinfo->smask);
+
+	spin_unlock(&pset->lock);
+
+	return 0;
 }
 
-static void tlb_sync(struct sbi_scratch *scratch)
+static int tlb_queue_dequeue(void *tlb_q, struct sbi_tlb_info *tinfo)
 {
-	atomic_t *tlb_sync =
-			sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+	struct tlb_pset *pset = tlb_q;
+	struct sbi_tlb_pending *drain = &pset->keys[pset->num_keys];
+	bool last;
+	u32 i;
+
+	if (!pset->draining) {
+		spin_lock(&pset->lock);
+		i = find_first_bit(pset->used, pset->num_keys);
+		if (i >= pset->num_keys) {
+			spin_unlock(&pset->lock);
+			return SBI_ENOENT;
+		}
+		*drain = pset->keys[i];
+		tlb_pset_delete(pset, i);
+		spin_unlock(&pset->lock);
 
-	while (atomic_read(tlb_sync) > 0) {
-		/*
-		 * While we are waiting for remote hart to set the sync,
-		 * consume fifo requests to avoid deadlock.
-		 */
-		tlb_process_once(scratch);
+		pset->draining = true;
+		pset->drain_pos = 0;
 	}
 
-	return;
+	tinfo->type = drain->type;
+	tinfo->asid = drain->asid;
+	tinfo->vmid = drain->vmid;
+	tinfo->gen = drain->gen;
+	if (drain->flush_all) {
+		tinfo->start = 0;
+		tinfo->size = SBI_TLB_FLUSH_ALL;
+		last = true;
+	} else {
+		tinfo->start = drain->start[pset->drain_pos];
+		tinfo->size = drain->end[pset->drain_pos] - tinfo->start;
+		last = (++pset->drain_pos >= drain->nranges) ? true : false;
+	}
+
+	/* Senders are released once all ranges of the key are flushed */
+	if (last) {
+		tinfo->smask = drain->smask;
+		pset->draining = false;
+	} else {
+		sbi_hartmask_clear_all(&tinfo->smask);
+	}
+
+	return 0;
 }
 
+#else
+
+#define TLB_QUEUE_SIZE		sizeof(struct sbi_fifo)
+
+#ifndef CONFIG_SBI_TLB_MULTICAST
+
 static inline int tlb_range_check(struct sbi_tlb_info *curr,
 					struct sbi_tlb_info *next)
 {
@@ -276,10 +877,12 @@ static inline int tlb_range_check(struct sbi_tlb_info *curr,
 	if (next->start <= curr->start && next_end > curr_end) {
 		curr->start = next->start;
 		curr->size  = next->size;
-		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
+		curr->gen   = MAX(curr->gen, next->gen);
+		tlb_smask_merge(&curr->smask, &next->smask);
 		ret = SBI_FIFO_UPDATED;
 	} else if (next->start >= curr->start && next_end <= curr_end) {
-		sbi_hartmask_or(&curr->smask, &curr->smask, &next->smask);
+		curr->gen = MAX(curr->gen, next->gen);
+		tlb_smask_merge(&curr->smask, &next->smask);
 		ret = SBI_FIFO_SKIP;
 	}
 
@@ -328,15 +931,190 @@ static int tlb_update_cb(void *in, void *data)
 	return ret;
 }
 
+#endif
+
+static u32 tlb_queue_num_entries(const struct sbi_platform *plat)
+{
+	return sbi_platform_tlb_fifo_num_entries(plat);
+}
+
+static unsigned long tlb_queue_mem_size(u32 entries)
+{
+	return entries * SBI_TLB_QUEUE_DATA_SIZE;
+}
+
+static int tlb_queue_init(void *tlb_q, void *tlb_mem, u32 entries)
+{
+	sbi_fifo_init(tlb_q, tlb_mem, entries, SBI_TLB_QUEUE_DATA_SIZE);
+	return 0;
+}
+
+static int tlb_queue_enqueue(void *tlb_q, void *data)
+{
+#ifndef CONFIG_SBI_TLB_MULTICAST
+	int ret = sbi_fifo_inplace_update(tlb_q, data, tlb_update_cb);
+
+	if (ret != SBI_FIFO_UNCHANGED)
+		return 0;
+#endif
+
+	return sbi_fifo_enqueue(tlb_q, data);
+}
+
+static int tlb_queue_dequeue(void *tlb_q, void *data)
+{
+	return sbi_fifo_dequeue(tlb_q, data);
+}
+
+#endif
+
+#ifdef CONFIG_SBI_TLB_MULTICAST
+
+static bool tlb_dequeue_process(void *tlb_q)
+{
+	struct sbi_tlb_ref ref;
+
+	if (!tlb_queue_dequeue(tlb_q, &ref)) {
+		tlb_entry_local_process(ref.info);
+		/* The sender may reuse its descriptor once this drops to 0 */
+		atomic_sub_return(ref.pending, 1);
+		return true;
+	}
+
+	return false;
+}
+
+#else
+
+static void tlb_entry_process(struct sbi_tlb_info *tinfo)
+{
+	u32 rindex;
+	struct sbi_scratch *rscratch = NULL;
+
+	tlb_entry_local_process(tinfo);
+
+	sbi_hartmask_for_each_hartindex(rindex, &tinfo->smask) {
+		rscratch = sbi_hartindex_to_scratch(rindex);
+		if (!rscratch)
+			continue;
+
+		tlb_sync_put(rscratch);
+	}
+}
+
+static bool tlb_dequeue_process(void *tlb_q)
+{
+	struct sbi_tlb_info tinfo;
+
+	if (!tlb_queue_dequeue(tlb_q, &tinfo)) {
+		tlb_entry_process(&tinfo);
+		return true;
+	}
+
+	return false;
+}
+
+#endif
+
+static bool tlb_process_once(struct sbi_scratch *scratch)
+{
+	void *tlb_q = sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
+
+	if (!tlb_dequeue_process(tlb_q))
+		return false;
+
+	/* Notify senders waiting for space in our queue */
+	atomic_add_return(sbi_scratch_offset_ptr(scratch, tlb_done_off), 1);
+
+	return true;
+}
+
+/*
+ * Wait until the value of given word is likely to differ from "old".
+ *
+ * With Zawrs, a reservation is registered on the word and the HART
+ * stalls in WRS.NTO until another HART writes to it or an interrupt
+ * (such as a remote fence IPI) becomes pending. Otherwise, the word is
+ * polled with plain loads for at most "spins" iterations which keeps
+ * the cache line shared instead of bouncing it between HARTs.
+ */
+static void tlb_wait_change(atomic_t *word, long old, unsigned long spins)
+{
+	long val;
+
+	if (sbi_hart_has_extension(sbi_scratch_thishart_ptr(),
+				   SBI_HART_EXT_ZAWRS)) {
+		__asm__ __volatile__(
+#if __riscv_xlen == 64
+			"lr.d %0, %1"
+#else
+			"lr.w %0, %1"
+#endif
+			: "=r"(val)
+			: "A"(word->counter)
+			: "memory");
+		if (val == old)
+			/* WRS.NTO */
+			__asm__ __volatile__(".word 0x00d00073" : : : "memory");
+		return;
+	}
+
+	while (spins-- && atomic_read(word) == old)
+		cpu_relax();
+}
+
+static void tlb_process(struct sbi_scratch *scratch)
+{
+	while (tlb_process_once(scratch));
+}
+
+static void tlb_sync(struct sbi_scratch *scratch)
+{
+	atomic_t *tlb_sync =
+			sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+	unsigned long spins = TLB_WAIT_SPINS_MIN;
+	long pending;
+
+#ifdef CONFIG_SBI_TLB_ASYNC
+	struct tlb_async *async = sbi_scratch_offset_ptr(scratch, tlb_async_off);
+
+	/* Completion of asynchronous requests is reported through the ring */
+	if (async->submitting)
+		return;
+#endif
+
+	while ((pending = atomic_read(tlb_sync)) > 0) {
+		/*
+		 * While we are waiting for remote hart to set the sync,
+		 * consume fifo requests to avoid deadlock.
+		 */
+		if (tlb_process_once(scratch)) {
+			spins = TLB_WAIT_SPINS_MIN;
+			continue;
+		}
+
+		/* Remote HARTs may wait for us to trigger them as leader */
+		sbi_ipi_forward(scratch);
+
+		tlb_wait_change(tlb_sync, pending, spins);
+		spins = MIN(spins << 1, TLB_WAIT_SPINS_MAX);
+	}
+
+	return;
+}
+
 static int tlb_update(struct sbi_scratch *scratch,
 			  struct sbi_scratch *remote_scratch,
 			  u32 remote_hartindex, void *data)
 {
-	int ret;
-	atomic_t *tlb_sync;
-	struct sbi_fifo *tlb_fifo_r;
+	atomic_t *tlb_sync, *tlb_done_r;
+	void *tlb_q_r, *tlb_data;
+	long done;
 	struct sbi_tlb_info *tinfo = data;
 	u32 curr_hartid = current_hartid();
+#ifdef CONFIG_SBI_TLB_MULTICAST
+	struct sbi_tlb_ref ref;
+#endif
 
 	/*
 	 * If the request is to queue a tlb flush entry for itself
@@ -347,28 +1125,51 @@ static int tlb_update(struct sbi_scratch *scratch,
 		return SBI_IPI_UPDATE_BREAK;
 	}
 
-	tlb_fifo_r = sbi_scratch_offset_ptr(remote_scratch, tlb_fifo_off);
+	tlb_q_r = sbi_scratch_offset_ptr(remote_scratch, tlb_fifo_off);
+	tlb_done_r = sbi_scratch_offset_ptr(remote_scratch, tlb_done_off);
+	tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
 
-	ret = sbi_fifo_inplace_update(tlb_fifo_r, data, tlb_update_cb);
+#ifdef CONFIG_SBI_TLB_MULTICAST
+	/* Queue a reference to the descriptor published by sbi_tlb_request() */
+	ref.info = sbi_scratch_offset_ptr(scratch, tlb_desc_off);
+	ref.pending = tlb_sync;
+	tlb_data = &ref;
+#else
+	tlb_data = tinfo;
+#endif
+
+	/*
+	 * Count the request before queueing it so that the count can not
+	 * transiently drop to zero when the target HART is faster.
+	 */
+	atomic_add_return(tlb_sync, 1);
+
+	done = atomic_read(tlb_done_r);
+	if (tlb_queue_enqueue(tlb_q_r, tlb_data) < 0) {
+		tlb_sync_put(scratch);
 
-	if (ret == SBI_FIFO_UNCHANGED && sbi_fifo_enqueue(tlb_fifo_r, data) < 0) {
 		/**
-		 * For now, Busy loop until there is space in the fifo.
-		 * There may be case where target hart is also
-		 * enqueue in source hart's fifo. Both hart may busy
-		 * loop leading to a deadlock.
-		 * TODO: Introduce a wait/wakeup event mechanism to handle
-		 * this properly.
+		 * The target hart may also be waiting for space in our
+		 * fifo so consume one of our own entries first to avoid
+		 * a deadlock. Then wait until the target hart signals
+		 * that it has consumed an entry instead of hammering
+		 * its fifo with enqueue attempts.
+		 *
+		 * The IPI for the queued entries may still be deferred
+		 * in the doorbell mask of another sender or handed over
+		 * to us as group leader so trigger the target hart and
+		 * our group before waiting on it.
 		 */
-		tlb_process_once(scratch);
 		sbi_dprintf("hart%d: hart%d tlb fifo full\n", curr_hartid,
 			    sbi_hartindex_to_hartid(remote_hartindex));
+		if (!tlb_process_once(scratch)) {
+			sbi_ipi_forward(scratch);
+			sbi_ipi_raw_send(remote_hartindex);
+			tlb_wait_change(tlb_done_r, done, TLB_WAIT_SPINS_MAX);
+		}
 		return SBI_IPI_UPDATE_RETRY;
 	}
 
-	tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
-	atomic_add_return(tlb_sync, 1);
-
 	return SBI_IPI_UPDATE_SUCCESS;
 }
 
@@ -401,29 +1202,331 @@ int sbi_tlb_request(ulong hmask, ulong hbase, struct sbi_tlb_info *tinfo)
 	 * upgrade it to flush all because we can only flush
 	 * 4KB at a time.
 	 */
-	if (tinfo->size > tlb_range_flush_limit) {
+	if (tinfo->size > tlb_range_flush_limit[tinfo->type]) {
 		tinfo->start = 0;
 		tinfo->size = SBI_TLB_FLUSH_ALL;
 	}
 
 	sbi_pmu_ctr_incr_fw(tlb_type_to_pmu_fw_event[tinfo->type]);
 
+	/* Stamp after the caller has updated its page tables */
+	tinfo->gen = tlb_gen_stamp();
+
+#ifdef CONFIG_SBI_TLB_MULTICAST
+	/*
+	 * The previous request of this HART has completed so none of
+	 * the receivers is referring to the descriptor anymore.
+	 */
+	sbi_memcpy(sbi_scratch_thishart_offset_ptr(tlb_desc_off),
+		   tinfo, sizeof(*tinfo));
+#endif
+
 	return sbi_ipi_send_many(hmask, hbase, tlb_event, tinfo);
 }
 
+int sbi_tlb_rfence_info_init(struct sbi_tlb_info *tinfo, unsigned long funcid,
+			     unsigned long start, unsigned long size,
+			     unsigned long id)
+{
+	unsigned long vmid;
+	u32 source_hart = current_hartid();
+
+	if (funcid >= SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA_VMID &&
+	    funcid <= SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA)
+		if (!misa_extension('H'))
+			return SBI_ENOTSUPP;
+
+	switch (funcid) {
+	case SBI_EXT_RFENCE_REMOTE_FENCE_I:
+		SBI_TLB_INFO_INIT(tinfo, 0, 0, 0, 0,
+				  SBI_TLB_FENCE_I, source_hart);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA:
+		SBI_TLB_INFO_INIT(tinfo, start, size, 0, 0,
+				  SBI_TLB_HFENCE_GVMA, source_hart);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_HFENCE_GVMA_VMID:
+		SBI_TLB_INFO_INIT(tinfo, start, size, 0, id,
+				  SBI_TLB_HFENCE_GVMA_VMID, source_hart);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA:
+		vmid = (csr_read(CSR_HGATP) & HGATP_VMID_MASK);
+		vmid = vmid >> HGATP_VMID_SHIFT;
+		SBI_TLB_INFO_INIT(tinfo, start, size, 0, vmid,
+				  SBI_TLB_HFENCE_VVMA, source_hart);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_HFENCE_VVMA_ASID:
+		vmid = (csr_read(CSR_HGATP) & HGATP_VMID_MASK);
+		vmid = vmid >> HGATP_VMID_SHIFT;
+		SBI_TLB_INFO_INIT(tinfo, start, size, id, vmid,
+				  SBI_TLB_HFENCE_VVMA_ASID, source_hart);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA:
+		SBI_TLB_INFO_INIT(tinfo, start, size, 0, 0,
+				  SBI_TLB_SFENCE_VMA, source_hart);
+		break;
+	case SBI_EXT_RFENCE_REMOTE_SFENCE_VMA_ASID:
+		SBI_TLB_INFO_INIT(tinfo, start, size, id, 0,
+				  SBI_TLB_SFENCE_VMA_ASID, source_hart);
+		break;
+	default:
+		return SBI_ENOTSUPP;
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_SBI_TLB_ASYNC
+
+static unsigned long tlb_async_ring_size(unsigned long num_entries)
+{
+	return sizeof(struct sbi_rfence_ring_header) +
+	       num_entries * sizeof(struct sbi_rfence_ring_desc);
+}
+
+int sbi_tlb_async_setup(unsigned long num_entries, unsigned long addr)
+{
+	ulong smode = (csr_read(CSR_MSTATUS) & MSTATUS_MPP) >>
+			MSTATUS_MPP_SHIFT;
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct tlb_async *async = sbi_scratch_offset_ptr(scratch, tlb_async_off);
+	struct sbi_rfence_ring_header *hdr;
+	unsigned long size;
+
+	/* Outstanding requests still have to report their completion */
+	if (atomic_read(sbi_scratch_offset_ptr(scratch, tlb_sync_off)))
+		return SBI_EINVALID_STATE;
+
+	/* Zero entries disable the ring */
+	if (!num_entries) {
+		spin_lock(&async->lock);
+		async->addr = 0;
+		spin_unlock(&async->lock);
+		return 0;
+	}
+
+	if ((num_entries & (num_entries - 1)) ||
+	    SBI_RFENCE_RING_MAX_ENTRIES < num_entries ||
+	    (addr & (sizeof(unsigned long) - 1)))
+		return SBI_EINVAL;
+
+	size = tlb_async_ring_size(num_entries);
+	if (!sbi_domain_check_addr_range(sbi_domain_thishart_ptr(), addr, size,
+					 smode, SBI_DOMAIN_READ | SBI_DOMAIN_WRITE))
+		return SBI_EINVALID_ADDR;
+
+	hdr = (struct sbi_rfence_ring_header *)addr;
+	sbi_hart_map_saddr(addr, sizeof(*hdr));
+	sbi_memset(hdr, 0, sizeof(*hdr));
+	sbi_hart_unmap_saddr();
+
+	spin_lock(&async->lock);
+	async->addr = addr;
+	async->num_entries = num_entries;
+	async->posted = 0;
+	async->done = 0;
+	spin_unlock(&async->lock);
+
+	return 0;
+}
+
+/*
+ * Submit the descriptors posted to the ring of the calling HART. The
+ * receiving HARTs are triggered but not waited for, the completion is
+ * reported through the "done" position of the ring.
+ */
+int sbi_tlb_async_doorbell(void)
+{
+	struct sbi_scratch *scratch = sbi_scratch_thishart_ptr();
+	struct tlb_async *async = sbi_scratch_offset_ptr(scratch, tlb_async_off);
+	struct sbi_rfence_ring_header *hdr;
+	struct sbi_rfence_ring_desc desc, *d, *descs;
+	struct sbi_tlb_info tinfo;
+	unsigned long head, tail;
+	int rc, ret = 0;
+
+	if (!async->addr)
+		return SBI_ENO_SHMEM;
+
+	hdr = (struct sbi_rfence_ring_header *)async->addr;
+	descs = (struct sbi_rfence_ring_desc *)(hdr + 1);
+	tail = async->posted;
+
+	/* Hold an extra count so completion is not reported mid-way */
+	atomic_add_return(sbi_scratch_offset_ptr(scratch, tlb_sync_off), 1);
+	async->submitting = true;
+
+	sbi_hart_map_saddr(async->addr, sizeof(*hdr));
+	head = __smp_load_acquire(&hdr->head);
+	sbi_hart_unmap_saddr();
+
+	while (1) {
+		if (head - tail > async->num_entries) {
+			/* S-mode posted beyond the free space of the ring */
+			ret = SBI_EINVAL;
+			break;
+		}
+
+		/*
+		 * Each descriptor is copied in and out separately so that
+		 * the shared memory is not mapped while submitting it.
+		 */
+		for (; tail != head; tail++) {
+			d = &descs[tail & (async->num_entries - 1)];
+
+			sbi_hart_map_saddr((unsigned long)d, sizeof(*d));
+			sbi_memcpy(&desc, d, sizeof(desc));
+			sbi_hart_unmap_saddr();
+
+			rc = sbi_tlb_rfence_info_init(&tinfo, desc.funcid,
+						      desc.start, desc.size,
+						      desc.id);
+			if (!rc)
+				rc = sbi_tlb_request(desc.hmask, desc.hbase,
+						     &tinfo);
+
+			sbi_hart_map_saddr((unsigned long)d, sizeof(*d));
+			d->error = rc;
+			sbi_hart_unmap_saddr();
+		}
+
+		spin_lock(&async->lock);
+		async->posted = tail;
+		spin_unlock(&async->lock);
+
+		/*
+		 * S-mode does not ring the doorbell again while it is set so
+		 * check for descriptors posted in the meantime after clearing.
+		 */
+		sbi_hart_map_saddr(async->addr, sizeof(*hdr));
+		__smp_store_release(&hdr->tail, tail);
+		hdr->doorbell = 0;
+		smp_mb();
+		head = hdr->head;
+		sbi_hart_unmap_saddr();
+
+		if (head == tail)
+			break;
+	}
+
+	async->submitting = false;
+	tlb_sync_put(scratch);
+
+	return ret;
+}
+
+#endif
+
+unsigned long sbi_tlb_range_flush_limit(enum sbi_tlb_type type)
+{
+	if (type < 0 || type >= SBI_TLB_TYPE_MAX)
+		return 0;
+
+	return tlb_range_flush_limit[type];
+}
+
+void sbi_tlb_range_flush_limit_override(unsigned long limit)
+{
+	tlb_range_flush_limit_fixed = limit;
+}
+
+bool sbi_tlb_range_flush_limit_calibrated(void)
+{
+	return tlb_range_flush_limit_measured;
+}
+
+#ifdef CONFIG_SBI_TLB_FLUSH_LIMIT_CALIBRATE
+
+#define TLB_CALIBRATE_PAGES		16
+#define TLB_CALIBRATE_ROUNDS		4
+#define TLB_CALIBRATE_MAX_PAGES		4096UL
+#define TLB_CALIBRATE_BASE		0x40000000UL
+
+static unsigned long tlb_calibrate_cycles(struct sbi_tlb_info *tinfo)
+{
+	unsigned long t, best = -1UL;
+	int i;
+
+	for (i = 0; i < TLB_CALIBRATE_ROUNDS; i++) {
+		t = csr_read(CSR_MCYCLE);
+		tlb_entry_local_process(tinfo);
+		t = csr_read(CSR_MCYCLE) - t;
+		best = MIN(best, t);
+	}
+
+	return best;
+}
+
+/*
+ * Find the range size for which flushing page by page costs as much
+ * as a full flush of the same fence type. The first round of each
+ * measurement warms up the code path so the minimum over all rounds
+ * is used.
+ */
+static void tlb_range_flush_limit_calibrate(void)
+{
+	unsigned long range_cycles, full_cycles, pages;
+	struct sbi_tlb_info tinfo;
+	enum sbi_tlb_type type;
+
+	for (type = SBI_TLB_SFENCE_VMA; type < SBI_TLB_TYPE_MAX; type++) {
+		switch (type) {
+		case SBI_TLB_HFENCE_GVMA_VMID:
+		case SBI_TLB_HFENCE_GVMA:
+		case SBI_TLB_HFENCE_VVMA_ASID:
+		case SBI_TLB_HFENCE_VVMA:
+			if (!misa_extension('H'))
+				continue;
+			break;
+		default:
+			if (!misa_extension('S'))
+				continue;
+			break;
+		}
+
+		SBI_TLB_INFO_INIT(&tinfo, TLB_CALIBRATE_BASE,
+				  TLB_CALIBRATE_PAGES * PAGE_SIZE, 0, 0, type,
+				  current_hartid());
+		range_cycles = tlb_calibrate_cycles(&tinfo);
+
+		tinfo.start = 0;
+		tinfo.size = SBI_TLB_FLUSH_ALL;
+		full_cycles = tlb_calibrate_cycles(&tinfo);
+
+		/* Counter not implemented or not running */
+		if (!range_cycles || !full_cycles)
+			return;
+
+		pages = (full_cycles * TLB_CALIBRATE_PAGES) / range_cycles;
+		pages = MIN(MAX(pages, 1UL), TLB_CALIBRATE_MAX_PAGES);
+		tlb_range_flush_limit[type] = pages * PAGE_SIZE;
+		tlb_range_flush_limit_measured = true;
+	}
+}
+
+#endif
+
 int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 {
+	enum sbi_tlb_type type;
+	unsigned long limit;
 	int ret;
-	void *tlb_mem;
-	atomic_t *tlb_sync;
-	struct sbi_fifo *tlb_q;
+	u32 tlb_entries;
+	void *tlb_mem, *tlb_q;
+	atomic_t *tlb_sync, *tlb_done;
+#ifdef CONFIG_SBI_TLB_ASYNC
+	struct tlb_async *async;
+#endif
 	const struct sbi_platform *plat = sbi_platform_ptr(scratch);
 
 	if (cold_boot) {
-		tlb_sync_off = sbi_scratch_alloc_offset(sizeof(*tlb_sync));
+		/* Pending counts are updated by the receiving HARTs */
+		tlb_sync_off = sbi_scratch_alloc_offset_aligned(
+					sizeof(*tlb_sync), sizeof(*tlb_sync),
+					SBI_SCRATCH_ALLOC_REMOTE);
 		if (!tlb_sync_off)
 			return SBI_ENOMEM;
-		tlb_fifo_off = sbi_scratch_alloc_offset(sizeof(*tlb_q));
+		tlb_fifo_off = sbi_scratch_alloc_offset(TLB_QUEUE_SIZE);
 		if (!tlb_fifo_off) {
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
@@ -434,39 +1537,124 @@ int sbi_tlb_init(struct sbi_scratch *scratch, bool cold_boot)
 			sbi_scratch_free_offset(tlb_sync_off);
 			return SBI_ENOMEM;
 		}
+		tlb_done_off = sbi_scratch_alloc_offset(sizeof(atomic_t));
+		if (!tlb_done_off) {
+			sbi_scratch_free_offset(tlb_fifo_mem_off);
+			sbi_scratch_free_offset(tlb_fifo_off);
+			sbi_scratch_free_offset(tlb_sync_off);
+			return SBI_ENOMEM;
+		}
+#ifdef CONFIG_SBI_TLB_FLUSH_GEN
+		tlb_gen_off = sbi_scratch_alloc_offset(sizeof(void *));
+		if (!tlb_gen_off) {
+			sbi_scratch_free_offset(tlb_done_off);
+			sbi_scratch_free_offset(tlb_fifo_mem_off);
+			sbi_scratch_free_offset(tlb_fifo_off);
+			sbi_scratch_free_offset(tlb_sync_off);
+			return SBI_ENOMEM;
+		}
+#endif
+#ifdef CONFIG_SBI_TLB_MULTICAST
+		tlb_desc_off = sbi_scratch_alloc_offset(SBI_TLB_INFO_SIZE);
+		if (!tlb_desc_off) {
+#ifdef CONFIG_SBI_TLB_FLUSH_GEN
+			sbi_scratch_free_offset(tlb_gen_off);
+#endif
+			sbi_scratch_free_offset(tlb_done_off);
+			sbi_scratch_free_offset(tlb_fifo_mem_off);
+			sbi_scratch_free_offset(tlb_fifo_off);
+			sbi_scratch_free_offset(tlb_sync_off);
+			return SBI_ENOMEM;
+		}
+#endif
+#ifdef CONFIG_SBI_TLB_ASYNC
+		tlb_async_off = sbi_scratch_alloc_offset(sizeof(struct tlb_async));
+		if (!tlb_async_off) {
+#ifdef CONFIG_SBI_TLB_FLUSH_GEN
+			sbi_scratch_free_offset(tlb_gen_off);
+#endif
+			sbi_scratch_free_offset(tlb_done_off);
+			sbi_scratch_free_offset(tlb_fifo_mem_off);
+			sbi_scratch_free_offset(tlb_fifo_off);
+			sbi_scratch_free_offset(tlb_sync_off);
+			return SBI_ENOMEM;
+		}
+#endif
 		ret = sbi_ipi_event_create(&tlb_ops);
 		if (ret < 0) {
+#ifdef CONFIG_SBI_TLB_ASYNC
+			sbi_scratch_free_offset(tlb_async_off);
+#endif
+#ifdef CONFIG_SBI_TLB_MULTICAST
+			sbi_scratch_free_offset(tlb_desc_off);
+#endif
+#ifdef CONFIG_SBI_TLB_FLUSH_GEN
+			sbi_scratch_free_offset(tlb_gen_off);
+#endif
+			sbi_scratch_free_offset(tlb_done_off);
 			sbi_scratch_free_offset(tlb_fifo_mem_off);
 			sbi_scratch_free_offset(tlb_fifo_off);
 			sbi_scratch_free_offset(tlb_sync_off);
 			return ret;
 		}
 		tlb_event = ret;
-		tlb_range_flush_limit = sbi_platform_tlbr_flush_limit(plat);
+
+		limit = sbi_platform_tlbr_flush_limit(plat);
+		if (sbi_hart_has_extension(scratch, SBI_HART_EXT_SVINVAL))
+			limit <<= TLB_SVINVAL_FLUSH_LIMIT_SHIFT;
+		if (tlb_range_flush_limit_fixed)
+			limit = tlb_range_flush_limit_fixed;
+		for (type = 0; type < SBI_TLB_TYPE_MAX; type++)
+			tlb_range_flush_limit[type] = limit;
+#ifdef CONFIG_SBI_TLB_FLUSH_LIMIT_CALIBRATE
+		if (!tlb_range_flush_limit_fixed)
+			tlb_range_flush_limit_calibrate();
+#endif
 	} else {
 		if (!tlb_sync_off ||
 		    !tlb_fifo_off ||
-		    !tlb_fifo_mem_off)
+		    !tlb_fifo_mem_off ||
+		    !tlb_done_off)
+			return SBI_ENOMEM;
+#ifdef CONFIG_SBI_TLB_FLUSH_GEN
+		if (!tlb_gen_off)
 			return SBI_ENOMEM;
+#endif
+#ifdef CONFIG_SBI_TLB_MULTICAST
+		if (!tlb_desc_off)
+			return SBI_ENOMEM;
+#endif
+#ifdef CONFIG_SBI_TLB_ASYNC
+		if (!tlb_async_off)
+			return SBI_ENOMEM;
+#endif
 		if (SBI_IPI_EVENT_MAX <= tlb_event)
 			return SBI_ENOSPC;
 	}
 
 	tlb_sync = sbi_scratch_offset_ptr(scratch, tlb_sync_off);
+	tlb_done = sbi_scratch_offset_ptr(scratch, tlb_done_off);
 	tlb_q = sbi_scratch_offset_ptr(scratch, tlb_fifo_off);
+	tlb_entries = tlb_queue_num_entries(plat);
 	tlb_mem = sbi_scratch_read_type(scratch, void *, tlb_fifo_mem_off);
 	if (!tlb_mem) {
-		tlb_mem = sbi_malloc(
-				sbi_platform_tlb_fifo_num_entries(plat) * SBI_TLB_INFO_SIZE);
+		tlb_mem = sbi_malloc(tlb_queue_mem_size(tlb_entries));
 		if (!tlb_mem)
 			return SBI_ENOMEM;
 		sbi_scratch_write_type(scratch, void *, tlb_fifo_mem_off, tlb_mem);
 	}
 
-	ATOMIC_INIT(tlb_sync, 0);
-
-	sbi_fifo_init(tlb_q, tlb_mem,
-		      sbi_platform_tlb_fifo_num_entries(plat), SBI_TLB_INFO_SIZE);
+	ret = tlb_gen_hart_init(scratch);
+	if (ret)
+		return ret;
 
-	return 0;
+	ATOMIC_INIT(tlb_sync, 0);
+	ATOMIC_INIT(tlb_done, 0);
+#ifdef CONFIG_SBI_TLB_ASYNC
+	async = sbi_scratch_offset_ptr(scratch, tlb_async_off);
+	sbi_memset(async, 0, sizeof(*async));
+	SPIN_LOCK_INIT(async->lock);
+#endif
+
+	return tlb_queue_init(tlb_q, tlb_mem, tlb_entries);
 }
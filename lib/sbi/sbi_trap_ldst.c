@@ -11,6 +11,7 @@
 #include <sbi/riscv_encoding.h>
 #include <sbi/riscv_fp.h>
 #include <sbi/sbi_error.h>
+#include <sbi/sbi_insn_cache.h>
 #include <sbi/sbi_trap_ldst.h>
 #include <sbi/sbi_trap.h>
 #include <sbi/sbi_unpriv.h>
@@ -44,34 +45,15 @@ static ulong sbi_misaligned_tinst_fixup(ulong orig_tinst, ulong new_tinst,
 		return orig_tinst | (addr_offset << SH_RS1);
 }
 
-static int sbi_trap_emulate_load(struct sbi_trap_context *tcntx,
-				 sbi_trap_ld_emulator emu)
+/**
+ * Decode a load instruction
+ *
+ * @return true if the instruction is a supported load
+ */
+static bool sbi_trap_decode_load(ulong insn, ulong insn_len,
+				 struct sbi_insn_info *info)
 {
-	const struct sbi_trap_info *orig_trap = &tcntx->trap;
-	struct sbi_trap_regs *regs = &tcntx->regs;
-	ulong insn, insn_len;
-	union sbi_ldst_data val = { 0 };
-	struct sbi_trap_info uptrap;
-	int rc, fp = 0, shift = 0, len = 0;
-
-	if (orig_trap->tinst & 0x1) {
-		/*
-		 * Bit[0] == 1 implies trapped instruction value is
-		 * transformed instruction or custom instruction.
-		 */
-		insn	 = orig_trap->tinst | INSN_16BIT_MASK;
-		insn_len = (orig_trap->tinst & 0x2) ? INSN_LEN(insn) : 2;
-	} else {
-		/*
-		 * Bit[0] == 0 implies trapped instruction value is
-		 * zero or special value.
-		 */
-		insn = sbi_get_insn(regs->mepc, &uptrap);
-		if (uptrap.cause) {
-			return sbi_trap_redirect(regs, &uptrap);
-		}
-		insn_len = INSN_LEN(insn);
-	}
+	int fp = 0, shift = 0, len = 0;
 
 	if ((insn & INSN_MASK_LB) == INSN_MATCH_LB) {
 		len   = 1;
@@ -145,57 +127,29 @@ static int sbi_trap_emulate_load(struct sbi_trap_context *tcntx,
 		shift = 8 * (sizeof(ulong) - len);
 		insn = RVC_RS2S(insn) << SH_RD;
 	} else {
-		return sbi_trap_redirect(regs, orig_trap);
+		return false;
 	}
 
-	rc = emu(len, &val, tcntx);
-	if (rc <= 0)
-		return rc;
-
-	if (!fp)
-		SET_RD(insn, regs, ((long)(val.data_ulong << shift)) >> shift);
-#ifdef __riscv_flen
-	else if (len == 8)
-		SET_F64_RD(insn, regs, val.data_u64);
-	else
-		SET_F32_RD(insn, regs, val.data_ulong);
-#endif
-
-	regs->mepc += insn_len;
+	info->insn     = insn;
+	info->insn_len = insn_len;
+	info->type     = SBI_INSN_LOAD;
+	info->len      = len;
+	info->shift    = shift;
+	info->fp       = fp;
 
-	return 0;
+	return true;
 }
 
-static int sbi_trap_emulate_store(struct sbi_trap_context *tcntx,
-				  sbi_trap_st_emulator emu)
+/**
+ * Decode a store instruction, the source register of compressed stores
+ * is moved to the RS2 field.
+ *
+ * @return true if the instruction is a supported store
+ */
+static bool sbi_trap_decode_store(ulong insn, ulong insn_len,
+				  struct sbi_insn_info *info)
 {
-	const struct sbi_trap_info *orig_trap = &tcntx->trap;
-	struct sbi_trap_regs *regs = &tcntx->regs;
-	ulong insn, insn_len;
-	union sbi_ldst_data val;
-	struct sbi_trap_info uptrap;
-	int rc, len = 0;
-
-	if (orig_trap->tinst & 0x1) {
-		/*
-		 * Bit[0] == 1 implies trapped instruction value is
-		 * transformed instruction or custom instruction.
-		 */
-		insn	 = orig_trap->tinst | INSN_16BIT_MASK;
-		insn_len = (orig_trap->tinst & 0x2) ? INSN_LEN(insn) : 2;
-	} else {
-		/*
-		 * Bit[0] == 0 implies trapped instruction value is
-		 * zero or special value.
-		 */
-		insn = sbi_get_insn(regs->mepc, &uptrap);
-		if (uptrap.cause) {
-			return sbi_trap_redirect(regs, &uptrap);
-		}
-		insn_len = INSN_LEN(insn);
-	}
-
-	val.data_ulong = GET_RS2(insn, regs);
+	int fp = 0, len = 0;
 
 	if ((insn & INSN_MASK_SB) == INSN_MATCH_SB) {
 		len = 1;
@@ -207,60 +161,231 @@ static int sbi_trap_emulate_store(struct sbi_trap_context *tcntx,
 #endif
 #ifdef __riscv_flen
 	} else if ((insn & INSN_MASK_FSD) == INSN_MATCH_FSD) {
-		len	     = 8;
-		val.data_u64 = GET_F64_RS2(insn, regs);
+		fp  = 1;
+		len = 8;
 	} else if ((insn & INSN_MASK_FSW) == INSN_MATCH_FSW) {
-		len	       = 4;
-		val.data_ulong = GET_F32_RS2(insn, regs);
+		fp  = 1;
+		len = 4;
 #endif
 	} else if ((insn & INSN_MASK_SH) == INSN_MATCH_SH) {
 		len = 2;
 #if __riscv_xlen >= 64
 	} else if ((insn & INSN_MASK_C_SD) == INSN_MATCH_C_SD) {
-		len	       = 8;
-		val.data_ulong = GET_RS2S(insn, regs);
+		len  = 8;
+		insn = RVC_RS2S(insn) << SH_RS2;
 	} else if ((insn & INSN_MASK_C_SDSP) == INSN_MATCH_C_SDSP) {
-		len	       = 8;
-		val.data_ulong = GET_RS2C(insn, regs);
+		len  = 8;
+		insn = RVC_RS2(insn) << SH_RS2;
 #endif
 	} else if ((insn & INSN_MASK_C_SW) == INSN_MATCH_C_SW) {
-		len	       = 4;
-		val.data_ulong = GET_RS2S(insn, regs);
+		len  = 4;
+		insn = RVC_RS2S(insn) << SH_RS2;
 	} else if ((insn & INSN_MASK_C_SWSP) == INSN_MATCH_C_SWSP) {
-		len	       = 4;
-		val.data_ulong = GET_RS2C(insn, regs);
+		len  = 4;
+		insn = RVC_RS2(insn) << SH_RS2;
 #ifdef __riscv_flen
 	} else if ((insn & INSN_MASK_C_FSD) == INSN_MATCH_C_FSD) {
-		len	     = 8;
-		val.data_u64 = GET_F64_RS2S(insn, regs);
+		fp   = 1;
+		len  = 8;
+		insn = RVC_RS2S(insn) << SH_RS2;
 	} else if ((insn & INSN_MASK_C_FSDSP) == INSN_MATCH_C_FSDSP) {
-		len	     = 8;
-		val.data_u64 = GET_F64_RS2C(insn, regs);
+		fp   = 1;
+		len  = 8;
+		insn = RVC_RS2(insn) << SH_RS2;
 #if __riscv_xlen == 32
 	} else if ((insn & INSN_MASK_C_FSW) == INSN_MATCH_C_FSW) {
-		len	       = 4;
-		val.data_ulong = GET_F32_RS2S(insn, regs);
+		fp   = 1;
+		len  = 4;
+		insn = RVC_RS2S(insn) << SH_RS2;
 	} else if ((insn & INSN_MASK_C_FSWSP) == INSN_MATCH_C_FSWSP) {
-		len	       = 4;
-		val.data_ulong = GET_F32_RS2C(insn, regs);
+		fp   = 1;
+		len  = 4;
+		insn = RVC_RS2(insn) << SH_RS2;
 #endif
 #endif
 	} else if ((insn & INSN_MASK_C_SH) == INSN_MATCH_C_SH) {
-		len		= 2;
-		val.data_ulong = GET_RS2S(insn, regs);
+		len  = 2;
+		insn = RVC_RS2S(insn) << SH_RS2;
 	} else {
-		return sbi_trap_redirect(regs, orig_trap);
+		return false;
 	}
 
-	rc = emu(len, val, tcntx);
+	info->insn     = insn;
+	info->insn_len = insn_len;
+	info->type     = SBI_INSN_STORE;
+	info->len      = len;
+	info->shift    = 0;
+	info->fp       = fp;
+
+	return true;
+}
+
+/**
+ * Fetch and decode the trapped load or store instruction. Instructions
+ * fetched with an unprivileged access are cached per HART.
+ *
+ * @return 0 on success, 1 if the instruction is not a load or store,
+ * 2 if fetching the instruction faulted and the fault was redirected,
+ * or negative error
+ */
+static int sbi_trap_decode_ldst(struct sbi_trap_context *tcntx, u8 type,
+				struct sbi_insn_info *info)
+{
+	const struct sbi_trap_info *orig_trap = &tcntx->trap;
+	struct sbi_trap_regs *regs = &tcntx->regs;
+	struct sbi_trap_info uptrap;
+	ulong insn, insn_len;
+	bool found;
+	int rc;
+
+	if (orig_trap->tinst & 0x1) {
+		/*
+		 * Bit[0] == 1 implies trapped instruction value is
+		 * transformed instruction or custom instruction.
+		 */
+		insn	 = orig_trap->tinst | INSN_16BIT_MASK;
+		insn_len = (orig_trap->tinst & 0x2) ? INSN_LEN(insn) : 2;
+	} else {
+		if (sbi_insn_cache_lookup(regs, type, info))
+			return 0;
+
+		/*
+		 * Bit[0] == 0 implies trapped instruction value is
+		 * zero or special value.
+		 */
+		insn = sbi_get_insn(regs->mepc, &uptrap);
+		if (uptrap.cause) {
+			rc = sbi_trap_redirect(regs, &uptrap);
+			return rc ? rc : 2;
+		}
+		insn_len = INSN_LEN(insn);
+	}
+
+	if (type == SBI_INSN_LOAD)
+		found = sbi_trap_decode_load(insn, insn_len, info);
+	else
+		found = sbi_trap_decode_store(insn, insn_len, info);
+	if (!found)
+		return 1;
+
+	if (!(orig_trap->tinst & 0x1))
+		sbi_insn_cache_insert(regs, info);
+
+	return 0;
+}
+
+static int sbi_trap_emulate_load(struct sbi_trap_context *tcntx,
+				 sbi_trap_ld_emulator emu)
+{
+	const struct sbi_trap_info *orig_trap = &tcntx->trap;
+	struct sbi_trap_regs *regs = &tcntx->regs;
+	union sbi_ldst_data val = { 0 };
+	struct sbi_insn_info info;
+	int rc;
+
+	rc = sbi_trap_decode_ldst(tcntx, SBI_INSN_LOAD, &info);
+	if (rc < 0)
+		return rc;
+	if (rc == 1)
+		return sbi_trap_redirect(regs, orig_trap);
+	if (rc)
+		return 0;
+
+	rc = emu(info.len, &val, tcntx);
+	if (rc <= 0)
+		return rc;
+
+	if (!info.fp)
+		SET_RD(info.insn, regs,
+		       ((long)(val.data_ulong << info.shift)) >> info.shift);
+#ifdef __riscv_flen
+	else if (info.len == 8)
+		SET_F64_RD(info.insn, regs, val.data_u64);
+	else
+		SET_F32_RD(info.insn, regs, val.data_ulong);
+#endif
+
+	regs->mepc += info.insn_len;
+
+	return 0;
+}
+
+static int sbi_trap_emulate_store(struct sbi_trap_context *tcntx,
+				  sbi_trap_st_emulator emu)
+{
+	const struct sbi_trap_info *orig_trap = &tcntx->trap;
+	struct sbi_trap_regs *regs = &tcntx->regs;
+	union sbi_ldst_data val;
+	struct sbi_insn_info info;
+	int rc;
+
+	rc = sbi_trap_decode_ldst(tcntx, SBI_INSN_STORE, &info);
+	if (rc < 0)
+		return rc;
+	if (rc == 1)
+		return sbi_trap_redirect(regs, orig_trap);
+	if (rc)
+		return 0;
+
+#ifdef __riscv_flen
+	if (info.fp && info.len == 8)
+		val.data_u64 = GET_F64_RS2(info.insn, regs);
+	else if (info.fp)
+		val.data_ulong = GET_F32_RS2(info.insn, regs);
+	else
+#endif
+		val.data_ulong = GET_RS2(info.insn, regs);
+
+	rc = emu(info.len, val, tcntx);
 	if (rc <= 0)
 		return rc;
 
-	regs->mepc += insn_len;
+	regs->mepc += info.insn_len;
 
 	return 0;
 }
 
+/*
+ * Each unprivileged access swaps MTVEC and toggles MPRV so misaligned
+ * accesses within a page are emulated with as few naturally aligned
+ * accesses as possible. Accesses crossing a page boundary or faulting
+ * are emulated byte by byte so that a redirected trap reports the exact
+ * faulting address.
+ */
+static inline bool sbi_misaligned_in_page(ulong addr, int len)
+{
+	return (len <= sizeof(ulong)) &&
+	       !((addr ^ (addr + len - 1)) & PAGE_MASK);
+}
+
+/* Load using the one or two aligned words covering the access */
+static bool sbi_misaligned_ld_words(ulong addr, int rlen,
+				    union sbi_ldst_data *out_val)
+{
+	ulong base = addr & ~(sizeof(ulong) - 1);
+	ulong shift = (addr - base) * 8;
+	struct sbi_trap_info uptrap;
+	ulong val, hi;
+
+	val = sbi_load_ulong((const ulong *)base, &uptrap);
+	if (uptrap.cause)
+		return false;
+	val >>= shift;
+
+	if (shift + rlen * 8 > __riscv_xlen) {
+		hi = sbi_load_ulong((const ulong *)base + 1, &uptrap);
+		if (uptrap.cause)
+			return false;
+		val |= hi << (__riscv_xlen - shift);
+	}
+
+	if (rlen < sizeof(ulong))
+		val &= (1UL << (rlen * 8)) - 1;
+	out_val->data_ulong = val;
+
+	return true;
+}
+
 static int sbi_misaligned_ld_emulator(int rlen, union sbi_ldst_data *out_val,
 				      struct sbi_trap_context *tcntx)
 {
@@ -269,6 +394,10 @@ static int sbi_misaligned_ld_emulator(int rlen, union sbi_ldst_data *out_val,
 	struct sbi_trap_info uptrap;
 	int i;
 
+	if (sbi_misaligned_in_page(orig_trap->tval, rlen) &&
+	    sbi_misaligned_ld_words(orig_trap->tval, rlen, out_val))
+		return rlen;
+
 	for (i = 0; i < rlen; i++) {
 		out_val->data_bytes[i] =
 			sbi_load_u8((void *)(orig_trap->tval + i), &uptrap);
@@ -286,15 +415,69 @@ int sbi_misaligned_load_handler(struct sbi_trap_context *tcntx)
 	return sbi_trap_emulate_load(tcntx, sbi_misaligned_ld_emulator);
 }
 
+/*
+ * Store using the largest naturally aligned accesses which exactly cover
+ * the access. Unlike loads, the surrounding bytes of an aligned word can
+ * not be rewritten as another HART may store to them concurrently.
+ *
+ * @return number of bytes stored before a fault
+ */
+static int sbi_misaligned_st_chunks(ulong addr, int wlen,
+				    union sbi_ldst_data in_val)
+{
+	struct sbi_trap_info uptrap;
+	int i = 0, k, n;
+	ulong val;
+
+	while (i < wlen) {
+		n = sizeof(ulong);
+		while (((addr + i) & (n - 1)) || (wlen - i) < n)
+			n >>= 1;
+
+		val = 0;
+		for (k = n - 1; k >= 0; k--)
+			val = (val << 8) | in_val.data_bytes[i + k];
+
+		switch (n) {
+#if __riscv_xlen == 64
+		case 8:
+			sbi_store_u64((void *)(addr + i), val, &uptrap);
+			break;
+#endif
+		case 4:
+			sbi_store_u32((void *)(addr + i), val, &uptrap);
+			break;
+		case 2:
+			sbi_store_u16((void *)(addr + i), val, &uptrap);
+			break;
+		default:
+			sbi_store_u8((void *)(addr + i), val, &uptrap);
+			break;
+		}
+		if (uptrap.cause)
+			break;
+
+		i += n;
+	}
+
+	return i;
+}
+
 static int sbi_misaligned_st_emulator(int wlen, union sbi_ldst_data in_val,
 				      struct sbi_trap_context *tcntx)
 {
 	const struct sbi_trap_info *orig_trap = &tcntx->trap;
 	struct sbi_trap_regs *regs = &tcntx->regs;
 	struct sbi_trap_info uptrap;
-	int i;
+	int i = 0;
+
+	if (sbi_misaligned_in_page(orig_trap->tval, wlen)) {
+		i = sbi_misaligned_st_chunks(orig_trap->tval, wlen, in_val);
+		if (i == wlen)
+			return wlen;
+	}
 
-	for (i = 0; i < wlen; i++) {
+	for (; i < wlen; i++) {
 		sbi_store_u8((void *)(orig_trap->tval + i),
 			     in_val.data_bytes[i], &uptrap);
 		if (uptrap.cause) {
@@ -0,0 +1,218 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * Per-HART trap statistics
+ *
+ * Only the owning HART updates its statistics block so the counters are
+ * plain 32-bit integers (which may wrap) without any locking. The block
+ * lives on the heap and is referenced from the scratch space.
+ */
+
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_bitops.h>
+#include <sbi/sbi_console.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_trap.h>
+#include <sbi/sbi_trap_stats.h>
+
+struct trap_stats_csr {
+	u32 csr_num;
+	u32 count;
+};
+
+struct trap_stats {
+	u32 exc[SBI_TRAP_STATS_CAUSES];
+	u32 irq[SBI_TRAP_STATS_IRQS];
+	u32 redirect[SBI_TRAP_STATS_CAUSES];
+	/** Traps taken while the HART was already in M-mode */
+	u32 nested;
+	/** Last entry accounts 16-bit instructions */
+	u32 illegal[SBI_TRAP_STATS_OPCODES + 1];
+	u32 csr_used;
+	/** Last slot accounts all CSRs which did not get a slot */
+	struct trap_stats_csr csr[SBI_TRAP_STATS_CSR_SLOTS + 1];
+};
+
+static unsigned long trap_stats_off;
+
+#define trap_stats_get(__scratch)					\
+	sbi_scratch_read_type((__scratch), struct trap_stats *,	\
+			      trap_stats_off)
+
+static inline struct trap_stats *trap_stats_thishart(void)
+{
+	if (!trap_stats_off)
+		return NULL;
+
+	return trap_stats_get(sbi_scratch_thishart_ptr());
+}
+
+void sbi_trap_stats_trap(const struct sbi_trap_context *tcntx)
+{
+	struct trap_stats *st = trap_stats_thishart();
+	ulong mcause = tcntx->trap.cause;
+
+	if (!st)
+		return;
+
+	if (mcause & MCAUSE_IRQ_MASK) {
+		mcause &= ~MCAUSE_IRQ_MASK;
+		if (mcause < SBI_TRAP_STATS_IRQS)
+			st->irq[mcause]++;
+	} else if (mcause < SBI_TRAP_STATS_CAUSES) {
+		st->exc[mcause]++;
+	}
+
+	if (((tcntx->regs.mstatus & MSTATUS_MPP) >> MSTATUS_MPP_SHIFT) == PRV_M)
+		st->nested++;
+}
+
+void sbi_trap_stats_exception(ulong cause)
+{
+	struct trap_stats *st = trap_stats_thishart();
+
+	if (st && cause < SBI_TRAP_STATS_CAUSES)
+		st->exc[cause]++;
+}
+
+void sbi_trap_stats_redirect(ulong cause)
+{
+	struct trap_stats *st = trap_stats_thishart();
+
+	if (st && cause < SBI_TRAP_STATS_CAUSES)
+		st->redirect[cause]++;
+}
+
+void sbi_trap_stats_illegal_insn(ulong insn)
+{
+	struct trap_stats *st = trap_stats_thishart();
+
+	if (!st)
+		return;
+
+	if ((insn & 3) != 3)
+		st->illegal[SBI_TRAP_STATS_OPCODES]++;
+	else
+		st->illegal[(insn & 0x7c) >> 2]++;
+}
+
+void sbi_trap_stats_csr(int csr_num)
+{
+	struct trap_stats *st = trap_stats_thishart();
+	u32 i, s;
+
+	if (!st)
+		return;
+
+	s = csr_num % SBI_TRAP_STATS_CSR_SLOTS;
+	for (i = 0; i < SBI_TRAP_STATS_CSR_SLOTS; i++) {
+		if (!(st->csr_used & BIT(s))) {
+			st->csr_used |= BIT(s);
+			st->csr[s].csr_num = csr_num;
+			break;
+		}
+		if (st->csr[s].csr_num == csr_num)
+			break;
+		s = (s + 1) % SBI_TRAP_STATS_CSR_SLOTS;
+	}
+	if (i == SBI_TRAP_STATS_CSR_SLOTS)
+		s = SBI_TRAP_STATS_CSR_SLOTS;
+
+	st->csr[s].count++;
+}
+
+static void trap_stats_dump_array(u32 hartid, const char *name,
+				  const u32 *counts, u32 num)
+{
+	bool empty = true;
+	u32 i;
+
+	for (i = 0; i < num; i++) {
+		if (!counts[i])
+			continue;
+		if (empty)
+			sbi_printf("hart%u %s:", hartid, name);
+		sbi_printf(" %u=%u", i, counts[i]);
+		empty = false;
+	}
+	if (!empty)
+		sbi_printf("\n");
+}
+
+static void trap_stats_dump_csr(u32 hartid, const struct trap_stats *st)
+{
+	u32 i;
+
+	if (!st->csr_used && !st->csr[SBI_TRAP_STATS_CSR_SLOTS].count)
+		return;
+
+	sbi_printf("hart%u emulated csr:", hartid);
+	for (i = 0; i < SBI_TRAP_STATS_CSR_SLOTS; i++) {
+		if (st->csr_used & BIT(i))
+			sbi_printf(" 0x%x=%u", st->csr[i].csr_num,
+				   st->csr[i].count);
+	}
+	if (st->csr[SBI_TRAP_STATS_CSR_SLOTS].count)
+		sbi_printf(" other=%u", st->csr[SBI_TRAP_STATS_CSR_SLOTS].count);
+	sbi_printf("\n");
+}
+
+void sbi_trap_stats_dump(void)
+{
+	struct sbi_scratch *scratch;
+	struct trap_stats *st;
+	u32 h, hartid;
+
+	if (!trap_stats_off)
+		return;
+
+	sbi_printf("Trap statistics, cause/opcode=count:\n");
+	for (h = 0; h <= sbi_scratch_last_hartindex(); h++) {
+		scratch = sbi_hartindex_to_scratch(h);
+		st = scratch ? trap_stats_get(scratch) : NULL;
+		if (!st)
+			continue;
+
+		hartid = sbi_hartindex_to_hartid(h);
+		trap_stats_dump_array(hartid, "exception", st->exc,
+				      SBI_TRAP_STATS_CAUSES);
+		trap_stats_dump_array(hartid, "interrupt", st->irq,
+				      SBI_TRAP_STATS_IRQS);
+		trap_stats_dump_array(hartid, "redirected", st->redirect,
+				      SBI_TRAP_STATS_CAUSES);
+		if (st->nested)
+			sbi_printf("hart%u from M-mode: %u\n",
+				   hartid, st->nested);
+		trap_stats_dump_array(hartid, "illegal opcode", st->illegal,
+				      SBI_TRAP_STATS_OPCODES);
+		if (st->illegal[SBI_TRAP_STATS_OPCODES])
+			sbi_printf("hart%u illegal 16-bit: %u\n", hartid,
+				   st->illegal[SBI_TRAP_STATS_OPCODES]);
+		trap_stats_dump_csr(hartid, st);
+	}
+}
+
+int sbi_trap_stats_init(struct sbi_scratch *scratch, bool cold_boot)
+{
+	struct trap_stats *st;
+
+	if (cold_boot) {
+		trap_stats_off = sbi_scratch_alloc_type_offset(void *);
+		if (!trap_stats_off)
+			return SBI_ENOMEM;
+	} else if (!trap_stats_off) {
+		return SBI_ENOMEM;
+	}
+
+	st = trap_stats_get(scratch);
+	if (!st) {
+		st = sbi_zalloc(sizeof(*st));
+		if (!st)
+			return SBI_ENOMEM;
+		sbi_scratch_write_type(scratch, void *, trap_stats_off, st);
+	}
+
+	return 0;
+}
@@ -7,10 +7,12 @@
  *   Anup Patel <anup.patel@wdc.com>
  */
 
+#include <sbi/riscv_asm.h>
 #include <sbi/riscv_encoding.h>
 #include <sbi/sbi_bitops.h>
 #include <sbi/sbi_hart.h>
 #include <sbi/sbi_scratch.h>
+#include <sbi/sbi_string.h>
 #include <sbi/sbi_trap.h>
 #include <sbi/sbi_unpriv.h>
 
@@ -167,3 +169,203 @@ ulong sbi_get_insn(ulong mepc, struct sbi_trap_info *trap)
 
 	return insn;
 }
+
+/*
+ * Bulk copies from/to lower privilege mode memory install the expected
+ * trap handler once and set MPRV around batches of word accesses, so the
+ * M-mode buffer is only accessed with MPRV cleared. A batch stops at the
+ * first fault because the trap switches MPP to M-mode for the remaining
+ * accesses.
+ */
+#define UNPRIV_COPY_BATCH	4
+
+/* @return number of words loaded before a fault */
+static ulong unpriv_load_words(ulong *buf, const ulong *src, ulong count,
+			       struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3") = (ulong)trap;
+	register ulong ttmp asm("a4") = 0;
+	ulong mstatus = 0, w0 = 0, w1 = 0, w2 = 0, w3 = 0;
+	ulong left = count;
+
+	asm volatile(
+	    "csrrs %[mstatus], " STR(CSR_MSTATUS) ", %[mprv]\n"
+	    ".option push\n"
+	    ".option norvc\n"
+	    REG_L " %[w0], 0(%[src])\n"
+	    "bnez %[ttmp], 1f\n"
+	    "addi %[left], %[left], -1\n"
+	    "beqz %[left], 1f\n"
+	    REG_L " %[w1], " SZREG "(%[src])\n"
+	    "bnez %[ttmp], 1f\n"
+	    "addi %[left], %[left], -1\n"
+	    "beqz %[left], 1f\n"
+	    REG_L " %[w2], " __REG_SEL(16, 8) "(%[src])\n"
+	    "bnez %[ttmp], 1f\n"
+	    "addi %[left], %[left], -1\n"
+	    "beqz %[left], 1f\n"
+	    REG_L " %[w3], " __REG_SEL(24, 12) "(%[src])\n"
+	    "bnez %[ttmp], 1f\n"
+	    "addi %[left], %[left], -1\n"
+	    ".option pop\n"
+	    "1: csrw " STR(CSR_MSTATUS) ", %[mstatus]"
+	    : [mstatus] "+&r"(mstatus), [tinfo] "+&r"(tinfo),
+	      [ttmp] "+&r"(ttmp), [left] "+&r"(left),
+	      [w0] "+&r"(w0), [w1] "+&r"(w1), [w2] "+&r"(w2), [w3] "+&r"(w3)
+	    : [mprv] "r"(MSTATUS_MPRV), [src] "r"(src)
+	    : "memory");
+
+	buf[0] = w0;
+	buf[1] = w1;
+	buf[2] = w2;
+	buf[3] = w3;
+
+	return count - left;
+}
+
+/* @return number of words stored before a fault */
+static ulong unpriv_store_words(ulong *dst, const ulong *buf, ulong count,
+				struct sbi_trap_info *trap)
+{
+	register ulong tinfo asm("a3") = (ulong)trap;
+	register ulong ttmp asm("a4") = 0;
+	ulong mstatus = 0, left = count;
+
+	asm volatile(
+	    "csrrs %[mstatus], " STR(CSR_MSTATUS) ", %[mprv]\n"
+	    ".option push\n"
+	    ".option norvc\n"
+	    REG_S " %[w0], 0(%[dst])\n"
+	    "bnez %[ttmp], 1f\n"
+	    "addi %[left], %[left], -1\n"
+	    "beqz %[left], 1f\n"
+	    REG_S " %[w1], " SZREG "(%[dst])\n"
+	    "bnez %[ttmp], 1f\n"
+	    "addi %[left], %[left], -1\n"
+	    "beqz %[left], 1f\n"
+	    REG_S " %[w2], " __REG_SEL(16, 8) "(%[dst])\n"
+	    "bnez %[ttmp], 1f\n"
+	    "addi %[left], %[left], -1\n"
+	    "beqz %[left], 1f\n"
+	    REG_S " %[w3], " __REG_SEL(24, 12) "(%[dst])\n"
+	    "bnez %[ttmp], 1f\n"
+	    "addi %[left], %[left], -1\n"
+	    ".option pop\n"
+	    "1: csrw " STR(CSR_MSTATUS) ", %[mstatus]"
+	    : [mstatus] "+&r"(mstatus), [tinfo] "+&r"(tinfo),
+	      [ttmp] "+&r"(ttmp), [left] "+&r"(left)
+	    : [mprv] "r"(MSTATUS_MPRV), [dst] "r"(dst),
+	      [w0] "r"(buf[0]), [w1] "r"(buf[1]),
+	      [w2] "r"(buf[2]), [w3] "r"(buf[3])
+	    : "memory");
+
+	return count - left;
+}
+
+static inline bool unpriv_aligned(const void *p)
+{
+	return !((ulong)p & (sizeof(ulong) - 1));
+}
+
+/**
+ * Copy a buffer from the memory of the lower privilege mode given by
+ * MPP/MPV using its address translation.
+ *
+ * @return number of bytes copied, less than len if the access at this
+ * offset faulted in which case trap describes the fault
+ */
+ulong sbi_copy_from_lower(void *dst, const void *src, ulong len,
+			  struct sbi_trap_info *trap)
+{
+	ulong buf[UNPRIV_COPY_BATCH];
+	ulong mtvec, i, n, done, off = 0;
+	u8 *d = dst;
+	const u8 *s = src;
+
+	trap->cause = 0;
+
+	/* Bytes up to the first aligned word of the source */
+	for (; off < len && !unpriv_aligned(s + off); off++) {
+		d[off] = sbi_load_u8(s + off, trap);
+		if (trap->cause)
+			return off;
+	}
+
+	mtvec = csr_swap(CSR_MTVEC, sbi_hart_expected_trap_addr());
+	while (sizeof(ulong) <= len - off) {
+		n = MIN((len - off) / sizeof(ulong), UNPRIV_COPY_BATCH);
+		done = unpriv_load_words(buf, (const ulong *)(s + off), n,
+					 trap);
+		if (unpriv_aligned(d + off)) {
+			for (i = 0; i < done; i++)
+				((ulong *)(d + off))[i] = buf[i];
+		} else {
+			sbi_memcpy(d + off, buf, done * sizeof(ulong));
+		}
+		off += done * sizeof(ulong);
+		if (trap->cause)
+			break;
+	}
+	csr_write(CSR_MTVEC, mtvec);
+	if (trap->cause)
+		return off;
+
+	for (; off < len; off++) {
+		d[off] = sbi_load_u8(s + off, trap);
+		if (trap->cause)
+			break;
+	}
+
+	return off;
+}
+
+/**
+ * Copy a buffer to the memory of the lower privilege mode given by
+ * MPP/MPV using its address translation.
+ *
+ * @return number of bytes copied, less than len if the access at this
+ * offset faulted in which case trap describes the fault
+ */
+ulong sbi_copy_to_lower(void *dst, const void *src, ulong len,
+			struct sbi_trap_info *trap)
+{
+	ulong buf[UNPRIV_COPY_BATCH] = { 0 };
+	ulong mtvec, i, n, done, off = 0;
+	u8 *d = dst;
+	const u8 *s = src;
+
+	trap->cause = 0;
+
+	/* Bytes up to the first aligned word of the destination */
+	for (; off < len && !unpriv_aligned(d + off); off++) {
+		sbi_store_u8(d + off, s[off], trap);
+		if (trap->cause)
+			return off;
+	}
+
+	mtvec = csr_swap(CSR_MTVEC, sbi_hart_expected_trap_addr());
+	while (sizeof(ulong) <= len - off) {
+		n = MIN((len - off) / sizeof(ulong), UNPRIV_COPY_BATCH);
+		if (unpriv_aligned(s + off)) {
+			for (i = 0; i < n; i++)
+				buf[i] = ((const ulong *)(s + off))[i];
+		} else {
+			sbi_memcpy(buf, s + off, n * sizeof(ulong));
+		}
+		done = unpriv_store_words((ulong *)(d + off), buf, n, trap);
+		off += done * sizeof(ulong);
+		if (trap->cause)
+			break;
+	}
+	csr_write(CSR_MTVEC, mtvec);
+	if (trap->cause)
+		return off;
+
+	for (; off < len; off++) {
+		sbi_store_u8(d + off, s[off], trap);
+		if (trap->cause)
+			break;
+	}
+
+	return off;
+}
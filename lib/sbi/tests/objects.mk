@@ -12,3 +12,12 @@ libsbi-objs-$(CONFIG_SBIUNIT) += tests/riscv_atomic_test.o
 
 carray-sbi_unit_tests-$(CONFIG_SBIUNIT) += locks_test_suite
 libsbi-objs-$(CONFIG_SBIUNIT) += tests/riscv_locks_test.o
+
+carray-sbi_unit_tests-$(CONFIG_SBIUNIT) += mpsc_ring_test_suite
+libsbi-objs-$(CONFIG_SBIUNIT) += tests/sbi_mpsc_ring_test.o
+
+carray-sbi_unit_tests-$(CONFIG_SBIUNIT) += heap_test_suite
+libsbi-objs-$(CONFIG_SBIUNIT) += tests/sbi_heap_test.o
+
+carray-sbi_unit_tests-$(CONFIG_SBIUNIT) += scratch_test_suite
+libsbi-objs-$(CONFIG_SBIUNIT) += tests/sbi_scratch_test.o
@@ -0,0 +1,206 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_encoding.h>
+#include <sbi/sbi_heap.h>
+#include <sbi/sbi_unit_test.h>
+
+#define HEAP_TEST_HARTS		4
+#define HEAP_TEST_ALIGN		64
+
+/* Rough sizes of the per-HART allocations done during warm boot */
+static const unsigned long heap_boot_sizes[] = {
+	24, 328, 64, 512, 96, 1152, 160, 200,
+};
+
+#define HEAP_TEST_ALLOCS	(HEAP_TEST_HARTS * array_size(heap_boot_sizes))
+
+static void *heap_test_ptrs[HEAP_TEST_ALLOCS];
+
+static bool heap_test_overlap(unsigned long count)
+{
+	unsigned long i, j, a, b;
+
+	for (i = 0; i < count; i++) {
+		a = (unsigned long)heap_test_ptrs[i];
+		for (j = i + 1; j < count; j++) {
+			b = (unsigned long)heap_test_ptrs[j];
+			if (a < b + heap_boot_sizes[j % array_size(heap_boot_sizes)] &&
+			    b < a + heap_boot_sizes[i % array_size(heap_boot_sizes)])
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/* Probe the largest block which can be allocated with a binary search */
+static unsigned long heap_test_largest_block(void)
+{
+	unsigned long lo = 0, hi = sbi_heap_free_space(), mid;
+	void *p;
+
+	while (lo < hi) {
+		mid = (lo + hi + HEAP_TEST_ALIGN) / 2;
+		mid &= ~((unsigned long)HEAP_TEST_ALIGN - 1);
+		if (mid <= lo)
+			break;
+		p = sbi_malloc(mid);
+		if (p) {
+			sbi_free(p);
+			lo = mid;
+		} else {
+			hi = mid - HEAP_TEST_ALIGN;
+		}
+	}
+
+	return lo;
+}
+
+static void heap_alloc_free_test(struct sbiunit_test_case *test)
+{
+	unsigned long free_before = sbi_heap_free_space();
+	unsigned long i, size, fails = 0;
+
+	for (i = 0; i < HEAP_TEST_ALLOCS; i++) {
+		size = heap_boot_sizes[i % array_size(heap_boot_sizes)];
+		heap_test_ptrs[i] = sbi_malloc(size);
+		if (!heap_test_ptrs[i] ||
+		    ((unsigned long)heap_test_ptrs[i] & (HEAP_TEST_ALIGN - 1)))
+			fails++;
+		else
+			sbi_memset(heap_test_ptrs[i], i, size);
+	}
+	SBIUNIT_ASSERT_EQ(test, fails, 0);
+	SBIUNIT_EXPECT(test, !heap_test_overlap(HEAP_TEST_ALLOCS));
+
+	for (i = 0; i < HEAP_TEST_ALLOCS; i++) {
+		size = heap_boot_sizes[i % array_size(heap_boot_sizes)];
+		if (((u8 *)heap_test_ptrs[i])[0] != (u8)i ||
+		    ((u8 *)heap_test_ptrs[i])[size - 1] != (u8)i)
+			fails++;
+	}
+	SBIUNIT_EXPECT_EQ(test, fails, 0);
+
+	/* Free in a different order than allocated */
+	for (i = 0; i < HEAP_TEST_ALLOCS; i += 2)
+		sbi_free(heap_test_ptrs[i]);
+	for (i = 1; i < HEAP_TEST_ALLOCS; i += 2)
+		sbi_free(heap_test_ptrs[i]);
+
+	SBIUNIT_EXPECT_EQ(test, sbi_heap_free_space(), free_before);
+}
+
+static void heap_stats_test(struct sbiunit_test_case *test)
+{
+	struct sbi_heap_stats before, after;
+	void *p[3];
+	unsigned long i;
+
+	if (sbi_heap_stats_read(&before))
+		return;
+
+	p[0] = sbi_malloc(24);
+	p[1] = sbi_zalloc(600);
+	p[2] = sbi_calloc(4, 1024);
+	sbi_heap_stats_read(&after);
+
+	SBIUNIT_EXPECT_EQ(test, after.used_blocks, before.used_blocks + 3);
+	SBIUNIT_EXPECT_EQ(test, after.allocs, before.allocs + 3);
+	SBIUNIT_EXPECT(test, before.used + 24 + 600 + 4096 <= after.used);
+	SBIUNIT_EXPECT(test, after.used <= after.peak_used);
+	SBIUNIT_EXPECT(test, after.largest_free <= after.free);
+
+	for (i = 0; i < array_size(p); i++)
+		sbi_free(p[i]);
+	sbi_heap_stats_read(&after);
+
+	SBIUNIT_EXPECT_EQ(test, after.used, before.used);
+	SBIUNIT_EXPECT_EQ(test, after.used_blocks, before.used_blocks);
+	SBIUNIT_EXPECT_EQ(test, after.frees, before.frees + 3);
+}
+
+/*
+ * Replay the allocations of all HARTs booting at once, interleaved by
+ * allocation step, then tear down every other HART. Reports the cycles
+ * per allocation and free, the space overhead over the requested sizes,
+ * the failed allocations and the largest allocatable block versus the
+ * free space left.
+ */
+static void heap_boot_pattern_bench(struct sbiunit_test_case *test)
+{
+	unsigned long free_before = sbi_heap_free_space();
+	unsigned long i, n, h, size, requested = 0, used, largest, fails = 0;
+	unsigned long alloc_cycles, free_cycles, start;
+
+	n = 0;
+	start = csr_read(CSR_MCYCLE);
+	for (i = 0; i < array_size(heap_boot_sizes); i++) {
+		for (h = 0; h < HEAP_TEST_HARTS; h++) {
+			size = heap_boot_sizes[i];
+			heap_test_ptrs[h * array_size(heap_boot_sizes) + i] =
+							sbi_malloc(size);
+			requested += size;
+			n++;
+		}
+	}
+	alloc_cycles = csr_read(CSR_MCYCLE) - start;
+
+	for (i = 0; i < HEAP_TEST_ALLOCS; i++) {
+		if (!heap_test_ptrs[i]) {
+			fails++;
+			requested -= heap_boot_sizes[i % array_size(heap_boot_sizes)];
+		}
+	}
+	used = free_before - sbi_heap_free_space();
+
+	/* Tear down odd HARTs and check what is left for a large block */
+	start = csr_read(CSR_MCYCLE);
+	for (h = 1; h < HEAP_TEST_HARTS; h += 2) {
+		for (i = 0; i < array_size(heap_boot_sizes); i++)
+			sbi_free(heap_test_ptrs[h * array_size(heap_boot_sizes) + i]);
+	}
+	free_cycles = csr_read(CSR_MCYCLE) - start;
+	largest = heap_test_largest_block();
+
+	sbi_printf("heap bench: %lu allocs (%lu failed) %lu cycles/alloc %lu cycles/free\n",
+		   n, fails, alloc_cycles / n, free_cycles / (n / 2));
+	sbi_printf("heap bench: requested %lu used %lu, largest block %lu of %lu free after teardown\n",
+		   requested, used, largest, sbi_heap_free_space());
+
+	for (h = 0; h < HEAP_TEST_HARTS; h += 2) {
+		for (i = 0; i < array_size(heap_boot_sizes); i++)
+			sbi_free(heap_test_ptrs[h * array_size(heap_boot_sizes) + i]);
+	}
+
+	SBIUNIT_EXPECT(test, requested <= used);
+	SBIUNIT_EXPECT_EQ(test, sbi_heap_free_space(), free_before);
+}
+
+static void heap_bogus_free_test(struct sbiunit_test_case *test)
+{
+	unsigned long free_before, size = 1024;
+	u8 *p = sbi_malloc(size);
+
+	SBIUNIT_ASSERT(test, p);
+	free_before = sbi_heap_free_space();
+
+	/* Pointers into a used block, including its last granule */
+	sbi_free(p + HEAP_TEST_ALIGN);
+	sbi_free(p + size - HEAP_TEST_ALIGN);
+	SBIUNIT_EXPECT_EQ(test, sbi_heap_free_space(), free_before);
+
+	sbi_free(p);
+	SBIUNIT_EXPECT(test, free_before < sbi_heap_free_space());
+}
+
+static struct sbiunit_test_case heap_test_cases[] = {
+	SBIUNIT_TEST_CASE(heap_alloc_free_test),
+	SBIUNIT_TEST_CASE(heap_bogus_free_test),
+	SBIUNIT_TEST_CASE(heap_stats_test),
+	SBIUNIT_TEST_CASE(heap_boot_pattern_bench),
+	SBIUNIT_END_CASE,
+};
+
+SBIUNIT_TEST_SUITE(heap_test_suite, heap_test_cases);
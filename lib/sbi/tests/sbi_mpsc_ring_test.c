@@ -0,0 +1,303 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#include <sbi/riscv_barrier.h>
+#include <sbi/sbi_error.h>
+#include <sbi/sbi_fifo.h>
+#include <sbi/sbi_mpsc_ring.h>
+#include <sbi/sbi_unit_test.h>
+
+#define RING_TEST_ENTRIES	8
+#define RING_TEST_CHECK_OPS	20000
+#define RING_TEST_PRODUCERS	4
+#define RING_TEST_MP_OPS	20000
+/* Empty polls after which the consumer gives up on missing entries */
+#define RING_TEST_MP_TIMEOUT	100000000UL
+
+struct ring_test_entry {
+	unsigned long seq;
+	unsigned long payload[3];
+	unsigned long tag;
+};
+
+static struct sbi_mpsc_ring test_ring;
+static struct sbi_fifo test_fifo;
+static char test_ring_mem[SBI_MPSC_RING_MEM_SIZE(RING_TEST_ENTRIES,
+					sizeof(struct ring_test_entry))]
+					__aligned(sizeof(unsigned long));
+static struct ring_test_entry test_fifo_mem[RING_TEST_ENTRIES];
+static unsigned long test_rand_state;
+
+static unsigned long test_rand(void)
+{
+	/* Simple LCG, good enough to shuffle enqueue/dequeue patterns */
+	test_rand_state = test_rand_state * 1103515245UL + 12345UL;
+	return test_rand_state >> 16;
+}
+
+static void test_entry_fill(struct ring_test_entry *e, unsigned long seq)
+{
+	e->seq = seq;
+	e->payload[0] = seq ^ 0x5a5a5a5aUL;
+	e->payload[1] = ~seq;
+	e->payload[2] = seq * 3;
+	e->tag = seq << 1;
+}
+
+static void ring_test_suite_init(void)
+{
+	test_rand_state = 0x2024;
+}
+
+static void ring_init_test(struct sbiunit_test_case *test)
+{
+	SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_init(&test_ring, test_ring_mem, 6,
+				sizeof(struct ring_test_entry)), SBI_EINVAL);
+	SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_init(&test_ring, test_ring_mem, 0,
+				sizeof(struct ring_test_entry)), SBI_EINVAL);
+	SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_init(&test_ring, test_ring_mem,
+				RING_TEST_ENTRIES, sizeof(struct ring_test_entry)), 0);
+	SBIUNIT_EXPECT(test, sbi_mpsc_ring_is_empty(&test_ring));
+}
+
+static void ring_full_empty_test(struct sbiunit_test_case *test)
+{
+	struct ring_test_entry in, out;
+	unsigned long i;
+
+	sbi_mpsc_ring_init(&test_ring, test_ring_mem, RING_TEST_ENTRIES,
+			   sizeof(struct ring_test_entry));
+
+	SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_dequeue(&test_ring, &out), SBI_ENOENT);
+
+	for (i = 0; i < RING_TEST_ENTRIES; i++) {
+		test_entry_fill(&in, i);
+		SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_enqueue(&test_ring, &in), 0);
+	}
+	SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_enqueue(&test_ring, &in), SBI_ENOSPC);
+	SBIUNIT_EXPECT(test, !sbi_mpsc_ring_is_empty(&test_ring));
+
+	for (i = 0; i < RING_TEST_ENTRIES; i++) {
+		test_entry_fill(&in, i);
+		SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_dequeue(&test_ring, &out), 0);
+		SBIUNIT_EXPECT_MEMEQ(test, &in, &out, sizeof(in));
+	}
+	SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_dequeue(&test_ring, &out), SBI_ENOENT);
+	SBIUNIT_EXPECT(test, sbi_mpsc_ring_is_empty(&test_ring));
+}
+
+/*
+ * Drive the ring and the spinlock protected fifo with the same random
+ * sequence of enqueue/dequeue operations over many laps of the ring and
+ * check that both report the same full/empty conditions and return the
+ * same entries in the same order. This runs on a single HART and does
+ * not exercise concurrent producers.
+ */
+static void ring_fifo_crosscheck_test(struct sbiunit_test_case *test)
+{
+	struct ring_test_entry in, ring_out, fifo_out;
+	unsigned long i, seq = 0, mismatches = 0;
+	int ring_rc, fifo_rc;
+
+	sbi_mpsc_ring_init(&test_ring, test_ring_mem, RING_TEST_ENTRIES,
+			   sizeof(struct ring_test_entry));
+	sbi_fifo_init(&test_fifo, test_fifo_mem, RING_TEST_ENTRIES,
+		      sizeof(struct ring_test_entry));
+
+	for (i = 0; i < RING_TEST_CHECK_OPS; i++) {
+		/* Bias towards enqueue in bursts so the full case is hit */
+		if ((test_rand() % 16) < ((i / 512) % 2 ? 6 : 10)) {
+			test_entry_fill(&in, seq++);
+			ring_rc = sbi_mpsc_ring_enqueue(&test_ring, &in);
+			fifo_rc = sbi_fifo_enqueue(&test_fifo, &in);
+			if (ring_rc != fifo_rc)
+				mismatches++;
+		} else {
+			ring_rc = sbi_mpsc_ring_dequeue(&test_ring, &ring_out);
+			fifo_rc = sbi_fifo_dequeue(&test_fifo, &fifo_out);
+			if (ring_rc != fifo_rc ||
+			    (!ring_rc && sbi_memcmp(&ring_out, &fifo_out,
+						    sizeof(ring_out))))
+				mismatches++;
+		}
+
+		if (sbi_mpsc_ring_is_empty(&test_ring) !=
+		    (bool)sbi_fifo_is_empty(&test_fifo))
+			mismatches++;
+	}
+
+	/* Drain both queues and compare the leftovers */
+	while (!sbi_fifo_dequeue(&test_fifo, &fifo_out)) {
+		if (sbi_mpsc_ring_dequeue(&test_ring, &ring_out) ||
+		    sbi_memcmp(&ring_out, &fifo_out, sizeof(ring_out)))
+			mismatches++;
+	}
+	SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_dequeue(&test_ring, &ring_out),
+			  SBI_ENOENT);
+
+	SBIUNIT_EXPECT_EQ(test, mismatches, 0);
+}
+
+struct ring_mp_result {
+	unsigned long received[RING_TEST_PRODUCERS];
+	unsigned long errors;
+	bool timeout;
+};
+
+static void test_entry_fill_mp(struct ring_test_entry *e, unsigned long tag,
+			       unsigned long seq)
+{
+	test_entry_fill(e, seq);
+	e->tag = tag;
+}
+
+/* Set by the consumer when it gives up so that no producer spins forever */
+static volatile bool ring_mp_abort;
+
+static void ring_mp_producer(void *arg, u32 index)
+{
+	struct ring_test_entry in;
+	unsigned long i;
+	int rc;
+
+	for (i = 0; i < RING_TEST_MP_OPS; i++) {
+		test_entry_fill_mp(&in, index, i);
+		while (1) {
+			if (arg == &test_ring)
+				rc = sbi_mpsc_ring_enqueue(&test_ring, &in);
+			else
+				rc = sbi_fifo_enqueue(&test_fifo, &in);
+			if (!rc)
+				break;
+			if (ring_mp_abort)
+				return;
+			cpu_relax();
+		}
+	}
+}
+
+/*
+ * Consume the entries of all producers and check that every entry
+ * arrives exactly once, in the order of its producer and intact.
+ */
+static void ring_mp_consume(void *queue, u32 producers,
+			    struct ring_mp_result *res)
+{
+	unsigned long got = 0, idle = 0, *next;
+	struct ring_test_entry out, exp;
+	int rc;
+
+	sbi_memset(res, 0, sizeof(*res));
+	while (got < producers * RING_TEST_MP_OPS) {
+		if (queue == &test_ring)
+			rc = sbi_mpsc_ring_dequeue(&test_ring, &out);
+		else
+			rc = sbi_fifo_dequeue(&test_fifo, &out);
+		if (rc) {
+			if (RING_TEST_MP_TIMEOUT < ++idle) {
+				ring_mp_abort = true;
+				res->timeout = true;
+				break;
+			}
+			cpu_relax();
+			continue;
+		}
+		idle = 0;
+		got++;
+
+		if (producers <= out.tag) {
+			res->errors++;
+			continue;
+		}
+		next = &res->received[out.tag];
+		test_entry_fill_mp(&exp, out.tag, *next);
+		if (sbi_memcmp(&out, &exp, sizeof(out)))
+			res->errors++;
+		(*next)++;
+	}
+}
+
+/*
+ * Several HARTs enqueue tagged sequences into the ring concurrently
+ * while this HART consumes them, then the same is done through the
+ * spinlock protected fifo. Both must deliver every sequence exactly
+ * once and in order. The test is skipped if no other HART joins.
+ */
+static void ring_multi_producer_test(struct sbiunit_test_case *test)
+{
+	struct ring_mp_result ring_res, fifo_res;
+	u32 i, producers, fifo_producers;
+
+	ring_mp_abort = false;
+	sbi_mpsc_ring_init(&test_ring, test_ring_mem, RING_TEST_ENTRIES,
+			   sizeof(struct ring_test_entry));
+	producers = sbiunit_harts_start(ring_mp_producer, &test_ring,
+					RING_TEST_PRODUCERS);
+	if (!producers) {
+		SBIUNIT_INFO(test, "no other HART available, skipped\n");
+		return;
+	}
+	ring_mp_consume(&test_ring, producers, &ring_res);
+	sbiunit_harts_wait();
+
+	ring_mp_abort = false;
+	sbi_fifo_init(&test_fifo, test_fifo_mem, RING_TEST_ENTRIES,
+		      sizeof(struct ring_test_entry));
+	fifo_producers = sbiunit_harts_start(ring_mp_producer, &test_fifo,
+					     producers);
+	ring_mp_consume(&test_fifo, fifo_producers, &fifo_res);
+	sbiunit_harts_wait();
+
+	SBIUNIT_EXPECT(test, !ring_res.timeout);
+	SBIUNIT_EXPECT_EQ(test, ring_res.errors, 0);
+	SBIUNIT_EXPECT(test, !fifo_res.timeout);
+	SBIUNIT_EXPECT_EQ(test, fifo_res.errors, 0);
+	SBIUNIT_EXPECT_EQ(test, fifo_producers, producers);
+	for (i = 0; i < producers; i++) {
+		SBIUNIT_EXPECT_EQ(test, ring_res.received[i], RING_TEST_MP_OPS);
+		SBIUNIT_EXPECT_EQ(test, fifo_res.received[i],
+				  ring_res.received[i]);
+	}
+	SBIUNIT_EXPECT(test, sbi_mpsc_ring_is_empty(&test_ring));
+}
+
+/*
+ * A slot reserved by a producer which has not yet published its entry
+ * must hide all later entries from the consumer.
+ */
+static void ring_unpublished_slot_test(struct sbiunit_test_case *test)
+{
+	struct ring_test_entry in, out;
+
+	sbi_mpsc_ring_init(&test_ring, test_ring_mem, RING_TEST_ENTRIES,
+			   sizeof(struct ring_test_entry));
+
+	/* Reserve position 0 without publishing it */
+	atomic_add_return(&test_ring.head, 1);
+
+	test_entry_fill(&in, 1);
+	SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_enqueue(&test_ring, &in), 0);
+	SBIUNIT_EXPECT(test, sbi_mpsc_ring_is_empty(&test_ring));
+	SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_dequeue(&test_ring, &out), SBI_ENOENT);
+
+	/* Publish position 0, both entries become visible in order */
+	*(volatile unsigned long *)test_ring_mem = 1;
+	SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_dequeue(&test_ring, &out), 0);
+	SBIUNIT_EXPECT_EQ(test, sbi_mpsc_ring_dequeue(&test_ring, &out), 0);
+	SBIUNIT_EXPECT_MEMEQ(test, &in, &out, sizeof(in));
+}
+
+static struct sbiunit_test_case mpsc_ring_test_cases[] = {
+	SBIUNIT_TEST_CASE(ring_init_test),
+	SBIUNIT_TEST_CASE(ring_full_empty_test),
+	SBIUNIT_TEST_CASE(ring_fifo_crosscheck_test),
+	SBIUNIT_TEST_CASE(ring_multi_producer_test),
+	SBIUNIT_TEST_CASE(ring_unpublished_slot_test),
+	SBIUNIT_END_CASE,
+};
+
+const struct sbiunit_test_suite mpsc_ring_test_suite = {
+	.name = "mpsc_ring_test_suite",
+	.cases = mpsc_ring_test_cases,
+	.init = ring_test_suite_init
+};
@@ -0,0 +1,73 @@
+/*
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_unit_test.h>
+
+#ifdef CONFIG_SBI_SCRATCH_REMOTE_ISOLATION
+#define LINE_SIZE		SBI_SCRATCH_CACHE_LINE_SIZE
+
+static bool scratch_same_line(unsigned long a, unsigned long b)
+{
+	return (a / LINE_SIZE) == (b / LINE_SIZE);
+}
+#endif
+
+static void scratch_reuse_test(struct sbiunit_test_case *test)
+{
+	unsigned long a, b, c, d, used = sbi_scratch_used_space();
+
+	a = sbi_scratch_alloc_offset(24);
+	b = sbi_scratch_alloc_offset(8);
+	SBIUNIT_ASSERT(test, a && b);
+
+	/* Free-ed space is handed out again */
+	sbi_scratch_free_offset(a);
+	c = sbi_scratch_alloc_offset(24);
+	SBIUNIT_EXPECT_EQ(test, c, a);
+
+	/* Freeing from the middle of an allocation is ignored */
+	sbi_scratch_free_offset(c + 8);
+	d = sbi_scratch_alloc_offset(8);
+	SBIUNIT_EXPECT_NE(test, d, c + 8);
+
+	sbi_scratch_free_offset(d);
+	sbi_scratch_free_offset(c);
+	sbi_scratch_free_offset(b);
+	SBIUNIT_EXPECT_EQ(test, sbi_scratch_used_space(), used);
+}
+
+static void scratch_remote_test(struct sbiunit_test_case *test)
+{
+	unsigned long r, a, b, used = sbi_scratch_used_space();
+
+	a = sbi_scratch_alloc_offset(8);
+	r = sbi_scratch_alloc_offset_aligned(sizeof(long), sizeof(long),
+					     SBI_SCRATCH_ALLOC_REMOTE);
+	b = sbi_scratch_alloc_offset(8);
+	SBIUNIT_ASSERT(test, a && r && b);
+
+#ifdef CONFIG_SBI_SCRATCH_REMOTE_ISOLATION
+	/* Remote-written data does not share its cache line */
+	SBIUNIT_EXPECT_EQ(test, r & (LINE_SIZE - 1), 0);
+	SBIUNIT_EXPECT(test, !scratch_same_line(r, a));
+	SBIUNIT_EXPECT(test, !scratch_same_line(r, b));
+	SBIUNIT_EXPECT(test, !scratch_same_line(r, SBI_SCRATCH_OPTIONS_OFFSET));
+#endif
+
+	/* Alignments which are not a power of two are rejected */
+	SBIUNIT_EXPECT_EQ(test, sbi_scratch_alloc_offset_aligned(8, 24, 0), 0);
+
+	sbi_scratch_free_offset(b);
+	sbi_scratch_free_offset(r);
+	sbi_scratch_free_offset(a);
+	SBIUNIT_EXPECT_EQ(test, sbi_scratch_used_space(), used);
+}
+
+static struct sbiunit_test_case scratch_test_cases[] = {
+	SBIUNIT_TEST_CASE(scratch_reuse_test),
+	SBIUNIT_TEST_CASE(scratch_remote_test),
+	SBIUNIT_END_CASE,
+};
+
+SBIUNIT_TEST_SUITE(scratch_test_suite, scratch_test_cases);
@@ -3,13 +3,114 @@
  *
  * Author: Ivan Orlov <ivan.orlov0322@gmail.com>
  */
+#include <sbi/riscv_asm.h>
+#include <sbi/riscv_atomic.h>
+#include <sbi/riscv_barrier.h>
 #include <sbi/sbi_unit_test.h>
 #include <sbi/sbi_types.h>
 #include <sbi/sbi_console.h>
+#include <sbi/sbi_ipi.h>
+#include <sbi/sbi_scratch.h>
+#include <sbi/sbi_timer.h>
 
 extern struct sbiunit_test_suite *sbi_unit_tests[];
 extern unsigned long sbi_unit_tests_size;
 
+/* Time given to the waiting HARTs to pick up test work */
+#define SBIUNIT_HARTS_JOIN_MS	100
+
+/*
+ * Work handed to the HARTs waiting in sbi_hsm_hart_wait(). A HART takes
+ * an index by incrementing joined and only runs the function if the
+ * index is below count, then waits for go so that all HARTs start
+ * together.
+ */
+struct sbiunit_harts_work {
+	sbiunit_hart_func func;
+	void *arg;
+	long count;
+	atomic_t joined;
+	atomic_t done;
+	u32 started;
+	unsigned long go;
+};
+
+static struct sbiunit_harts_work harts_work;
+static struct sbiunit_harts_work *harts_work_ptr;
+
+void sbiunit_hsm_wait_poll(void)
+{
+	struct sbiunit_harts_work *w;
+	long index;
+
+	/* A HSM start is still seen by the caller through the HART state */
+	sbi_ipi_raw_clear(sbi_hartid_to_hartindex(current_hartid()));
+
+	w = __smp_load_acquire(&harts_work_ptr);
+	if (!w)
+		return;
+
+	index = atomic_add_return(&w->joined, 1) - 1;
+	if (w->count <= index)
+		return;
+
+	while (!__smp_load_acquire(&w->go))
+		cpu_relax();
+
+	w->func(w->arg, index);
+	atomic_add_return(&w->done, 1);
+}
+
+static bool sbiunit_harts_joined(void *arg)
+{
+	struct sbiunit_harts_work *w = arg;
+	u32 i, self = sbi_hartid_to_hartindex(current_hartid());
+
+	/* HARTs reaching the HSM wait late may have cleared the first IPI */
+	for (i = 0; i <= sbi_scratch_last_hartindex(); i++) {
+		if (i != self && sbi_hartindex_to_scratch(i))
+			sbi_ipi_raw_send(i);
+	}
+
+	return w->count <= atomic_read(&w->joined);
+}
+
+u32 sbiunit_harts_start(sbiunit_hart_func func, void *arg, u32 count)
+{
+	struct sbiunit_harts_work *w = &harts_work;
+	long joined;
+
+	if (!count || !sbi_timer_get_device())
+		return 0;
+
+	w->func = func;
+	w->arg = arg;
+	w->count = count;
+	ATOMIC_INIT(&w->joined, 0);
+	ATOMIC_INIT(&w->done, 0);
+	w->go = 0;
+	__smp_store_release(&harts_work_ptr, w);
+
+	sbi_timer_waitms_until(sbiunit_harts_joined, w, SBIUNIT_HARTS_JOIN_MS);
+
+	/* HARTs joining from now on get an index beyond count */
+	joined = atomic_xchg(&w->joined, count);
+	w->started = (joined < count) ? joined : count;
+	__smp_store_release(&w->go, 1);
+
+	return w->started;
+}
+
+void sbiunit_harts_wait(void)
+{
+	struct sbiunit_harts_work *w = &harts_work;
+
+	while (atomic_read(&w->done) < w->started)
+		cpu_relax();
+
+	__smp_store_release(&harts_work_ptr, NULL);
+}
+
 static void run_test_suite(struct sbiunit_test_suite *suite)
 {
 	struct sbiunit_test_case *s_case;
@@ -319,6 +319,56 @@ int fdt_parse_max_enabled_hart_id(void *fdt, u32 *max_hartid)
 	return 0;
 }
 
+#define FDT_CPU_MAP_MAX_DEPTH		8
+
+/**
+ * Find the innermost cpu-map cluster node which contains the given
+ * cpu node. Returns the cluster node offset or a negative error code.
+ */
+int fdt_parse_cpu_cluster(void *fdt, int cpu_offset)
+{
+	int map_offset, node, len, depth = 0;
+	int path[FDT_CPU_MAP_MAX_DEPTH];
+	const fdt32_t *val;
+	const char *name;
+	u32 phandle;
+
+	if (!fdt || cpu_offset < 0)
+		return SBI_EINVAL;
+
+	phandle = fdt_get_phandle(fdt, cpu_offset);
+	if (!phandle)
+		return SBI_ENOENT;
+
+	map_offset = fdt_path_offset(fdt, "/cpus/cpu-map");
+	if (map_offset < 0)
+		return SBI_ENOENT;
+
+	node = map_offset;
+	while (1) {
+		node = fdt_next_node(fdt, node, &depth);
+		if (node < 0 || depth <= 0)
+			break;
+		if (depth >= FDT_CPU_MAP_MAX_DEPTH)
+			continue;
+		path[depth] = node;
+
+		val = fdt_getprop(fdt, node, "cpu", &len);
+		if (!val || len < sizeof(fdt32_t) ||
+		    fdt32_to_cpu(*val) != phandle)
+			continue;
+
+		while (--depth > 0) {
+			name = fdt_get_name(fdt, path[depth], NULL);
+			if (name && !strncmp(name, "cluster", strlen("cluster")))
+				return path[depth];
+		}
+		break;
+	}
+
+	return SBI_ENOENT;
+}
+
 int fdt_parse_timebase_frequency(void *fdt, unsigned long *freq)
 {
 	const fdt32_t *val;
@@ -13,6 +13,7 @@
 #include <sbi/riscv_asm.h>
 #include <sbi/riscv_io.h>
 #include <sbi/sbi_domain.h>
+#include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_ipi.h>
 #include <sbi_utils/ipi/andes_plicsw.h>
 
@@ -41,6 +42,38 @@ static void plicsw_ipi_send(u32 hart_index)
 	writel_relaxed(BIT(pending_bit), (void *)pending_reg);
 }
 
+static void plicsw_ipi_send_mask(const struct sbi_hartmask *mask)
+{
+	u32 i, target_hart, interrupt_id, word_index, pending = 0;
+	u32 pending_word = 0;
+
+	/*
+	 * HART indices are iterated in increasing order which usually
+	 * means increasing HART IDs, so merge the pending bits of all
+	 * target harts sharing a pending register into a single write.
+	 */
+	sbi_hartmask_for_each_hartindex(i, mask) {
+		target_hart = sbi_hartindex_to_hartid(i);
+		if (plicsw.hart_count <= target_hart)
+			ebreak();
+
+		interrupt_id = target_hart + 1;
+		word_index   = interrupt_id / 32;
+		if (pending && word_index != pending_word) {
+			writel_relaxed(pending, (void *)(plicsw.addr +
+				       PLICSW_PENDING_BASE + pending_word * 4));
+			pending = 0;
+		}
+
+		pending_word = word_index;
+		pending |= BIT(interrupt_id % 32);
+	}
+
+	if (pending)
+		writel_relaxed(pending, (void *)(plicsw.addr +
+			       PLICSW_PENDING_BASE + pending_word * 4));
+}
+
 static void plicsw_ipi_clear(u32 hart_index)
 {
 	u32 target_hart = sbi_hartindex_to_hartid(hart_index);
@@ -62,6 +95,7 @@ static void plicsw_ipi_clear(u32 hart_index)
 static struct sbi_ipi_device plicsw_ipi = {
 	.name      = "andes_plicsw",
 	.ipi_send  = plicsw_ipi_send,
+	.ipi_send_mask = plicsw_ipi_send_mask,
 	.ipi_clear = plicsw_ipi_clear
 };
 
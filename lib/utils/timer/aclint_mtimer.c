@@ -69,6 +69,21 @@ static u64 mtimer_value(void)
 	return mt->time_rd((void *)mt->mtime_addr);
 }
 
+static volatile u64 *mtimer_value_addr(void)
+{
+	struct aclint_mtimer_data *mt;
+
+	mt = mtimer_get_hart_data_ptr(sbi_scratch_thishart_ptr());
+	if (!mt)
+		return NULL;
+#if __riscv_xlen != 32
+	if (!mt->has_64bit_mmio)
+		return NULL;
+#endif
+
+	return (void *)mt->mtime_addr;
+}
+
 static void mtimer_event_stop(void)
 {
 	u32 target_hart = current_hartid();
@@ -105,6 +120,7 @@ static void mtimer_event_start(u64 next_event)
 static struct sbi_timer_device mtimer = {
 	.name = "aclint-mtimer",
 	.timer_value = mtimer_value,
+	.timer_value_addr = mtimer_value_addr,
 	.timer_event_start = mtimer_event_start,
 	.timer_event_stop = mtimer_event_stop
 };
@@ -11,8 +11,10 @@
 #include <platform_override.h>
 #include <sbi/riscv_asm.h>
 #include <sbi/sbi_bitops.h>
+#include <sbi/sbi_ecall.h>
 #include <sbi/sbi_hartmask.h>
 #include <sbi/sbi_heap.h>
+#include <sbi/sbi_ipi.h>
 #include <sbi/sbi_platform.h>
 #include <sbi/sbi_string.h>
 #include <sbi/sbi_system.h>
@@ -64,7 +66,13 @@ static u32 fw_platform_calculate_heap_size(u32 hart_count)
 	heap_size = SBI_PLATFORM_DEFAULT_HEAP_SIZE(hart_count);
 
 	/* For TLB fifo */
-	heap_size += SBI_TLB_INFO_SIZE * (hart_count) * (hart_count);
+	heap_size += SBI_TLB_QUEUE_ENTRY_SIZE * (hart_count) * (hart_count);
+
+	/* For TLB flush generations */
+	heap_size += SBI_TLB_FLUSH_GEN_HEAP_SIZE * (hart_count);
+
+	/* For SBI call latency histograms */
+	heap_size += SBI_ECALL_STATS_HEAP_SIZE * (hart_count);
 
 	return BIT_ALIGN(heap_size, HEAP_BASE_ALIGN);
 }
@@ -219,10 +227,76 @@ static int generic_nascent_init(void)
 	return 0;
 }
 
+/*
+ * The "tlb-range-flush-limit" DT property in "/chosen/opensbi-config"
+ * DT node overrides both the platform and the calibrated remote fence
+ * range flush limit.
+ */
+static void generic_tlbr_flush_limit_init(void *fdt)
+{
+	int chosen_offset, config_offset, len;
+	const fdt32_t *val;
+	u64 limit;
+
+	chosen_offset = fdt_path_offset(fdt, "/chosen");
+	if (chosen_offset < 0)
+		return;
+
+	config_offset = fdt_node_offset_by_compatible(fdt, chosen_offset,
+						      "opensbi,config");
+	if (config_offset < 0)
+		return;
+
+	val = fdt_getprop(fdt, config_offset, "tlb-range-flush-limit", &len);
+	if (!val || len < sizeof(fdt32_t))
+		return;
+
+	limit = fdt32_to_cpu(val[0]);
+	if (len >= 2 * sizeof(fdt32_t))
+		limit = (limit << 32) | fdt32_to_cpu(val[1]);
+	if (limit)
+		sbi_tlb_range_flush_limit_override(limit);
+}
+
+#ifdef CONFIG_SBI_IPI_TREE_FANOUT
+/*
+ * Group the HARTs by their cpu-map cluster for hierarchical IPI fan-out.
+ */
+static void generic_ipi_groups_init(void *fdt)
+{
+	int cpus_offset, cpu_offset, cluster;
+	u32 hartid, hartindex;
+
+	cpus_offset = fdt_path_offset(fdt, "/cpus");
+	if (cpus_offset < 0)
+		return;
+
+	fdt_for_each_subnode(cpu_offset, fdt, cpus_offset) {
+		if (fdt_parse_hart_id(fdt, cpu_offset, &hartid))
+			continue;
+
+		hartindex = sbi_hartid_to_hartindex(hartid);
+		if (!sbi_hartindex_valid(hartindex))
+			continue;
+
+		cluster = fdt_parse_cpu_cluster(fdt, cpu_offset);
+		if (cluster < 0)
+			continue;
+
+		sbi_ipi_set_hart_group(hartindex, cluster);
+	}
+}
+#endif
+
 static int generic_early_init(bool cold_boot)
 {
-	if (cold_boot)
+	if (cold_boot) {
 		fdt_reset_init();
+		generic_tlbr_flush_limit_init(fdt_get_address());
+#ifdef CONFIG_SBI_IPI_TREE_FANOUT
+		generic_ipi_groups_init(fdt_get_address());
+#endif
+	}
 
 	if (!generic_plat || !generic_plat->early_init)
 		return 0;